@@ -454,6 +454,19 @@ DQLITE_API int dqlite_node_set_snapshot_params_v2(dqlite_node *n,
  */
 DQLITE_API int dqlite_node_set_block_size(dqlite_node *n, size_t size);
 
+/**
+ * Set the maximum number of raft log writes that can be in flight at the same
+ * time against the same segment.
+ *
+ * Allowing more than one write lets new entries be written while earlier ones
+ * are still being persisted, which helps throughput on devices that handle
+ * several requests in parallel. The default is 1.
+ *
+ * This function must be called before calling dqlite_node_start().
+ */
+DQLITE_API int dqlite_node_set_max_concurrent_writes(dqlite_node *n,
+						     unsigned n_writes);
+
 /**
  * Set the target number of voting nodes for the cluster.
  *
@@ -479,9 +492,11 @@ DQLITE_API int dqlite_node_set_target_standbys(dqlite_node *n, int standbys);
 
 /**
  * Set the target number of threads in the thread pool processing sqlite3 disk
- * operations.
+ * operations. Statements against the same database always run on the same
+ * thread of the pool.
  *
- * The default pool thread count is 4.
+ * The default pool thread count is 4, the maximum is 1024. This must be called
+ * before dqlite_node_start.
  */
 DQLITE_API int dqlite_node_set_pool_thread_count(dqlite_node *n,
 						 unsigned thread_count);
@@ -506,6 +521,54 @@ DQLITE_API int dqlite_node_set_auto_recovery(dqlite_node *n, bool enabled);
 DQLITE_API int dqlite_node_set_snapshot_compression(dqlite_node *n,
 						    bool enabled);
 
+/**
+ * Enable or disable LZ4 compression of the database pages replicated through
+ * the raft log.
+ *
+ * Nodes running a version of dqlite that doesn't support it fail to apply
+ * compressed entries, so it must only be enabled once the whole cluster has
+ * been upgraded. Returns DQLITE_MISUSE if dqlite was built without liblz4.
+ *
+ * Compression is disabled by default.
+ */
+DQLITE_API int dqlite_node_set_frames_compression(dqlite_node *n,
+						  bool enabled);
+
+/**
+ * Limit the AppendEntries messages that this node sends to followers when it's
+ * the leader.
+ *
+ * `max_entries` and `max_size` : Maximum number of log entries, and maximum
+ * total size of their payloads, sent in a single message. A message always
+ * carries at least one entry.
+ *
+ * `window` : Maximum number of messages carrying entries that can be in
+ * flight to a follower at once. When set, a lagging follower is sent that many
+ * messages right away.
+ *
+ * Zero means no limit, which is the default for all of them.
+ */
+DQLITE_API int dqlite_node_set_append_entries_limits(dqlite_node *n,
+						     unsigned max_entries,
+						     size_t max_size,
+						     unsigned window);
+
+/**
+ * Split the pages written by a transaction into raft entries of at most
+ * @size bytes each, rather than replicating them as a single entry.
+ *
+ * This bounds the size of the raft entries, and so the memory needed to
+ * replicate and apply them, when transactions write lots of pages. Followers
+ * keep the pages of a transaction aside until they receive its last entry.
+ * Nodes running a version of dqlite that doesn't support it fail to apply
+ * those entries, so it must only be set once the whole cluster has been
+ * upgraded. Entries always hold at least one page.
+ *
+ * Passing zero, the default, disables splitting.
+ */
+DQLITE_API int dqlite_node_set_transaction_chunk_size(dqlite_node *n,
+						      size_t size);
+
 /**
  * Enable automatic role management on the server side for this node.
  *
@@ -1,6 +1,10 @@
 #include <sqlite3.h>
 #include <stdint.h>
 
+#ifdef LZ4_AVAILABLE
+#include <lz4.h>
+#endif
+
 #include "../include/dqlite.h"
 
 #include "command.h"
@@ -155,6 +159,173 @@ int command__encode(int type, const void *command, struct raft_buffer *buf)
 	return rc;
 }
 
+#ifdef LZ4_AVAILABLE
+/* A COMMAND_FRAMES_LZ4 command starts with the same fields as COMMAND_FRAMES
+ * up to the page numbers. They are followed by:
+ *
+ *  64 bits: Size of the LZ4 block in bytes.
+ *  LZ4 block holding the content of all pages, padded to a full 64-bit word.
+ */
+#define FRAMES_LZ4(X, ...)                    \
+	X(text, filename, ##__VA_ARGS__)      \
+	X(uint64, tx_id, ##__VA_ARGS__)       \
+	X(uint32, truncate, ##__VA_ARGS__)    \
+	X(uint8, is_commit, ##__VA_ARGS__)    \
+	X(uint8, __unused1__, ##__VA_ARGS__)  \
+	X(uint16, __unused2__, ##__VA_ARGS__) \
+	X(uint32, n_pages, ##__VA_ARGS__)     \
+	X(uint16, page_size, ##__VA_ARGS__)   \
+	X(uint16, __unused3__, ##__VA_ARGS__)
+SERIALIZE__DEFINE(framesLz4, FRAMES_LZ4);
+SERIALIZE__IMPLEMENT(framesLz4, FRAMES_LZ4);
+
+/* Return 1 if compressing the pages doesn't save any space. */
+static int encodeFramesLz4(const struct command_frames *c,
+			   struct raft_buffer *buf)
+{
+	const frames_t *frames = &c->frames;
+	const struct framesLz4 f = {
+		.filename = c->filename,
+		.tx_id = c->tx_id,
+		.truncate = c->truncate,
+		.is_commit = c->is_commit,
+		.n_pages = frames->n_pages,
+		.page_size = frames->page_size,
+	};
+	struct header h = { .format = FORMAT, .type = COMMAND_FRAMES_LZ4 };
+	size_t n = (size_t)frames->n_pages * frames->page_size;
+	size_t head;
+	uint64_t size;
+	char *pages;
+	char *cursor;
+	int bound;
+	int rv;
+
+	if (n == 0 || n > LZ4_MAX_INPUT_SIZE) {
+		return 1;
+	}
+	bound = LZ4_compressBound((int)n);
+
+	pages = sqlite3_malloc64(n);
+	if (pages == NULL) {
+		return DQLITE_NOMEM;
+	}
+	for (uint32_t i = 0; i < frames->n_pages; i++) {
+		memcpy(pages + (size_t)i * frames->page_size, frames->pages[i],
+		       frames->page_size);
+	}
+
+	head = header__sizeof(&h) + framesLz4__sizeof(&f) +
+	       sizeof(uint64_t) * frames->n_pages + sizeof(uint64_t);
+	buf->base = raft_malloc(head + BytePad64((size_t)bound));
+	if (buf->base == NULL) {
+		sqlite3_free(pages);
+		return DQLITE_NOMEM;
+	}
+	rv = LZ4_compress_default(pages, (char *)buf->base + head, (int)n,
+				  bound);
+	sqlite3_free(pages);
+	if (rv <= 0 || BytePad64((size_t)rv) + sizeof(uint64_t) >= n) {
+		raft_free(buf->base);
+		return 1;
+	}
+	size = (uint64_t)rv;
+	buf->len = head + BytePad64((size_t)size);
+	memset((char *)buf->base + head + size, 0,
+	       BytePad64((size_t)size) - (size_t)size);
+
+	cursor = buf->base;
+	header__encode(&h, &cursor);
+	framesLz4__encode(&f, &cursor);
+	for (uint32_t i = 0; i < frames->n_pages; i++) {
+		uint64__encode(&frames->page_numbers[i], &cursor);
+	}
+	uint64__encode(&size, &cursor);
+	return 0;
+}
+
+static int decodeFramesLz4(struct cursor *cursor, struct command_frames *c)
+{
+	struct framesLz4 f;
+	frames_t *frames = &c->frames;
+	uint64_t size;
+	size_t n;
+	char *data;
+	int rv;
+
+	rv = framesLz4__decode(cursor, &f);
+	if (rv != 0) {
+		return rv;
+	}
+	*c = (struct command_frames){
+		.filename = f.filename,
+		.tx_id = f.tx_id,
+		.truncate = f.truncate,
+		.is_commit = f.is_commit,
+		.frames = {
+			.n_pages = f.n_pages,
+			.page_size = f.page_size,
+		},
+	};
+	n = (size_t)frames->n_pages * frames->page_size;
+	if (n == 0 || n > LZ4_MAX_INPUT_SIZE) {
+		return DQLITE_PARSE;
+	}
+
+	rv = page_numbers__decode(cursor, frames);
+	if (rv != 0) {
+		return rv;
+	}
+	rv = uint64__decode(cursor, &size);
+	if (rv != 0 || size > INT32_MAX || cursor->cap < BytePad64(size)) {
+		rv = DQLITE_PARSE;
+		goto err;
+	}
+
+	/* A single allocation holds both the array of page pointers and the
+	 * content of the pages. */
+	frames->pages =
+	    sqlite3_malloc64(sizeof *frames->pages * frames->n_pages + n);
+	if (frames->pages == NULL) {
+		rv = DQLITE_NOMEM;
+		goto err;
+	}
+	data = (char *)&frames->pages[frames->n_pages];
+	if (LZ4_decompress_safe(cursor->p, data, (int)size, (int)n) != (int)n) {
+		sqlite3_free(frames->pages);
+		rv = DQLITE_PARSE;
+		goto err;
+	}
+	for (uint32_t i = 0; i < frames->n_pages; i++) {
+		frames->pages[i] = data + (size_t)i * frames->page_size;
+	}
+	cursor->p += BytePad64(size);
+	cursor->cap -= BytePad64(size);
+	return 0;
+
+err:
+	sqlite3_free(frames->page_numbers);
+	return rv;
+}
+#endif
+
+int command__encode_frames(const struct command_frames *command,
+			   bool compress,
+			   struct raft_buffer *buf)
+{
+#ifdef LZ4_AVAILABLE
+	if (compress) {
+		int rv = encodeFramesLz4(command, buf);
+		if (rv != 1) {
+			return rv;
+		}
+	}
+#else
+	(void)compress;
+#endif
+	return command__encode(COMMAND_FRAMES, command, buf);
+}
+
 #define DECODE(LOWER, UPPER, _)                                         \
 	case COMMAND_##UPPER:                                           \
 		*command = raft_malloc(sizeof(struct command_##LOWER)); \
@@ -182,6 +353,16 @@ int command__decode(const struct raft_buffer *buf, int *type, void **command)
 	}
 	switch (h.type) {
 		COMMAND__TYPES(DECODE, )
+#ifdef LZ4_AVAILABLE
+		case COMMAND_FRAMES_LZ4:
+			*command = raft_malloc(sizeof(struct command_frames));
+			if (*command == NULL) {
+				return DQLITE_NOMEM;
+			}
+			rc = decodeFramesLz4(&cursor, *command);
+			h.type = COMMAND_FRAMES;
+			break;
+#endif
 		default:
 			rc = DQLITE_PROTO;
 			break;
@@ -10,8 +10,15 @@
 #include "lib/serialize.h"
 #include "raft.h"
 
-/* Command type codes */
-enum { COMMAND_OPEN = 1, COMMAND_FRAMES, COMMAND_UNDO, COMMAND_CHECKPOINT };
+/* Command type codes. COMMAND_FRAMES_LZ4 is the encoding of a COMMAND_FRAMES
+ * command with LZ4-compressed pages, it decodes to a COMMAND_FRAMES command. */
+enum {
+	COMMAND_OPEN = 1,
+	COMMAND_FRAMES,
+	COMMAND_UNDO,
+	COMMAND_CHECKPOINT,
+	COMMAND_FRAMES_LZ4
+};
 
 /* Hold information about an array of WAL frames. */
 struct frames
@@ -55,6 +62,13 @@ DQLITE_VISIBLE_TO_TESTS int command__encode(int type,
 					    const void *command,
 					    struct raft_buffer *buf);
 
+/* Encode a frames command. If @compress is true and liblz4 is available the
+ * pages are compressed, unless that doesn't save any space. */
+DQLITE_VISIBLE_TO_TESTS int command__encode_frames(
+    const struct command_frames *command,
+    bool compress,
+    struct raft_buffer *buf);
+
 DQLITE_VISIBLE_TO_TESTS int command__decode(const struct raft_buffer *buf,
 					    int *type,
 					    void **command);
@@ -22,6 +22,15 @@
  * soon as possible. */
 #define DEFAULT_CHECKPOINT_THRESHOLD 1000
 
+/* Size in bytes of the body of a ROWS or FILES response above which it gets
+ * compressed, for clients that negotiated compression. */
+#define DEFAULT_COMPRESSION_THRESHOLD 1024
+
+/* Number of SQLite virtual machine instructions that the first batch of a
+ * read-only query can execute on the event loop thread before being moved to
+ * the thread pool. */
+#define DEFAULT_QUERY_INLINE_BUDGET 10000
+
 /* For generating unique replication/VFS registration names. */
 static _Atomic unsigned serial = 1;
 
@@ -47,6 +56,8 @@ int config__init(struct config *c,
 		.voters = 3,
 		.standbys = 0,
 		.pool_thread_count = 4,
+		.compression_threshold = DEFAULT_COMPRESSION_THRESHOLD,
+		.query_inline_budget = DEFAULT_QUERY_INLINE_BUDGET,
 	};
 
 	c->address = sqlite3_malloc((int)strlen(address) + 1);
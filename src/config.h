@@ -20,6 +20,10 @@ struct config {
 	int voters;                        /* Target number of voters */
 	int standbys;                      /* Target number of standbys */
 	unsigned pool_thread_count; /* Number of threads in thread pool */
+	unsigned compression_threshold; /* Min response size to compress */
+	unsigned query_inline_budget; /* VM steps a query may run on the loop */
+	bool frames_compression; /* Whether to LZ4-compress replicated pages */
+	size_t tx_chunk_size; /* Max pages size of a raft entry, 0 for no limit */
 };
 
 /**
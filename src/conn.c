@@ -1,5 +1,10 @@
+#include <string.h>
 #include <uv.h>
 
+#ifdef LZ4_AVAILABLE
+#include <lz4.h>
+#endif
+
 #include "conn.h"
 #include "gateway.h"
 #include "leader.h"
@@ -13,6 +18,18 @@
 
 #define conn_trace(C, fmt, ...) tracef("[conn %p] "fmt, (void*)C, ##__VA_ARGS__)
 
+/* Minimum amount of bytes to ask the socket for when reading requests, so
+ * that a request and its body, and possibly the requests following it, can be
+ * received with a single read. */
+#define CONN_READ_AHEAD 4096
+
+/* Protocol features supported by this server. */
+#ifdef LZ4_AVAILABLE
+#define CONN_FEATURES DQLITE_PROTOCOL_FEATURE_LZ4
+#else
+#define CONN_FEATURES 0
+#endif
+
 /* Initialize the given buffer for reading, ensure it has the given size. */
 static int init_read(struct conn *c, uv_buf_t *buf, size_t size)
 {
@@ -29,12 +46,30 @@ static int read_message(struct conn *c);
 static void conn_write_cb(struct transport *transport, int status)
 {
 	struct conn *c = transport->data;
+	uv_buf_t *bufs;
+	unsigned n;
 	bool finished;
 	int rv;
 	if (status != 0) {
 		conn_trace(c, "write cb status %d", status);
+		gateway__stream_end(&c->gateway);
 		goto abort;
 	}
+	if (c->closed) {
+		gateway__stream_end(&c->gateway);
+	}
+
+	/* Write the next chunk of a streamed response, if any. */
+	gateway__stream(&c->gateway, &bufs, &n);
+	if (n > 0) {
+		rv = transport__writev(&c->transport, bufs, n, conn_write_cb);
+		if (rv != 0) {
+			conn_trace(c, "transport write failed %d", rv);
+			gateway__stream_end(&c->gateway);
+			goto abort;
+		}
+		return;
+	}
 
 	buffer__reset(&c->write);
 	buffer__advance(&c->write, message__sizeof(&c->response)); /* Header */
@@ -57,6 +92,78 @@ abort:
 	conn__stop(c);
 }
 
+#ifdef LZ4_AVAILABLE
+/* Compress the response held in the write buffer into the compressed buffer,
+ * making @buf point to it. The compressed body is laid out as:
+ *
+ *  64 bits: Size of the uncompressed body in bytes.
+ *  64 bits: Size of the LZ4 block in bytes.
+ *  LZ4 block, padded to a full 64-bit word.
+ *
+ * Return non-zero if the response should be sent uncompressed, either because
+ * compression failed or because it would not save any space. */
+static int compress_response(struct conn *c, uv_buf_t *buf)
+{
+	struct message message = c->response;
+	size_t header = message__sizeof(&message);
+	uint64_t n = buffer__offset(&c->write) - header;
+	uint64_t size;
+	size_t total;
+	char *cursor;
+	int bound;
+	int rv;
+
+	if (n > LZ4_MAX_INPUT_SIZE) {
+		return -1;
+	}
+	bound = LZ4_compressBound((int)n);
+
+	buffer__reset(&c->compressed);
+	cursor = buffer__advance(&c->compressed,
+				 header + 2 * sizeof(uint64_t) +
+				     BytePad64((size_t)bound));
+	if (cursor == NULL) {
+		return DQLITE_NOMEM;
+	}
+	rv = LZ4_compress_default(buffer__cursor(&c->write, header),
+				  cursor + header + 2 * sizeof(uint64_t),
+				  (int)n, bound);
+	if (rv <= 0) {
+		return DQLITE_ERROR;
+	}
+	size = (uint64_t)rv;
+	total = 2 * sizeof(uint64_t) + BytePad64((size_t)size);
+	if (total >= n) {
+		return -1;
+	}
+	memset(cursor + header + 2 * sizeof(uint64_t) + size, 0,
+	       BytePad64((size_t)size) - (size_t)size);
+
+	message.words = (uint32_t)(total / 8);
+	message.extra = DQLITE_MESSAGE_LZ4;
+	message__encode(&message, &cursor);
+	uint64__encode(&n, &cursor);
+	uint64__encode(&size, &cursor);
+
+	buf->base = buffer__cursor(&c->compressed, 0);
+	buf->len = header + total;
+	return 0;
+}
+
+/* Return true if the response of the given type and body size should be
+ * compressed. */
+static bool should_compress(struct conn *c, uint8_t type, size_t n)
+{
+	if (!(c->features & DQLITE_PROTOCOL_FEATURE_LZ4)) {
+		return false;
+	}
+	if (type != DQLITE_RESPONSE_ROWS && type != DQLITE_RESPONSE_FILES) {
+		return false;
+	}
+	return n >= c->config->compression_threshold;
+}
+#endif
+
 static void gateway_handle_cb(struct handle *req,
 			      int status,
 			      uint8_t type,
@@ -79,9 +186,10 @@ static void gateway_handle_cb(struct handle *req,
 
 	n = buffer__offset(&c->write) - message__sizeof(&c->response);
 	dqlite_assert(n % 8 == 0);
+	dqlite_assert(req->stream_len % 8 == 0);
 
 	c->response.type = type;
-	c->response.words = (uint32_t)(n / 8);
+	c->response.words = (uint32_t)((n + req->stream_len) / 8);
 	c->response.schema = schema;
 	c->response.extra = 0;
 
@@ -91,9 +199,19 @@ static void gateway_handle_cb(struct handle *req,
 	buf.base = buffer__cursor(&c->write, 0);
 	buf.len = buffer__offset(&c->write);
 
+#ifdef LZ4_AVAILABLE
+	if (req->stream_len == 0 && should_compress(c, type, n) &&
+	    compress_response(c, &buf) != 0) {
+		/* Fall back to sending the response uncompressed. */
+		buf.base = buffer__cursor(&c->write, 0);
+		buf.len = buffer__offset(&c->write);
+	}
+#endif
+
 	rv = transport__write(&c->transport, &buf, conn_write_cb);
 	if (rv != 0) {
 		conn_trace(c, "transport write failed %d", rv);
+		gateway__stream_end(&c->gateway);
 		conn__stop(c);
 	}
 }
@@ -101,6 +219,12 @@ static void gateway_handle_cb(struct handle *req,
 static void transportCloseCb(struct transport *transport)
 {
 	struct conn *c = transport->data;
+	/* Pending writes have been cancelled by now, so it's safe to drop
+	 * the pages of a streamed response. */
+	gateway__stream_end(&c->gateway);
+	if (c->features & DQLITE_PROTOCOL_FEATURE_LZ4) {
+		buffer__close(&c->compressed);
+	}
 	buffer__close(&c->write);
 	buffer__close(&c->read);
 	if (c->close_cb != NULL) {
@@ -128,31 +252,36 @@ static void raft_connect(struct conn *c)
 	transportCloseCb(&c->transport);
 }
 
-static void read_request_cb(struct transport *transport, int status)
+/* Dispatch the request held at the beginning of the read buffer. */
+static void handle_request(struct conn *c)
 {
-	struct conn *c = transport->data;
 	struct cursor *cursor = &c->handle.cursor;
+	size_t header = message__sizeof(&c->request);
 	int rv;
 
-	if (status != 0) {
-		conn_trace(c, "read error %d", status);
-		// errorf(c->logger, "read error");
-		conn__stop(c);
-		return;
-	}
-
-	cursor->p = buffer__cursor(&c->read, 0);
-	cursor->cap = buffer__offset(&c->read);
+	cursor->p = buffer__cursor(&c->read, header);
+	cursor->cap = c->request.words * 8;
 
 	buffer__reset(&c->write);
 	buffer__advance(&c->write, message__sizeof(&c->response)); /* Header */
 
 	switch (c->request.type) {
 		case DQLITE_REQUEST_CONNECT:
+			/* The stream is handed over to raft, which must see
+			 * any data following this request. */
+			if (c->read_len > c->read_pos) {
+				conn_trace(c, "data past connect request");
+				conn__stop(c);
+				return;
+			}
 			raft_connect(c);
 			return;
 	}
 
+	/* This is not a raft connection, so it's now safe to read past the
+	 * end of the current request. */
+	c->read_ahead = true;
+
 	rv = gateway__handle(&c->gateway, &c->handle, c->request.type,
 			     c->request.schema, &c->write, gateway_handle_cb);
 	if (rv != 0) {
@@ -161,34 +290,11 @@ static void read_request_cb(struct transport *transport, int status)
 	}
 }
 
-/* Start reading the body of the next request */
-static int read_request(struct conn *c)
-{
-	uv_buf_t buf;
-	int rv;
-	if (UINT64_C(8) * (uint64_t)c->request.words > (uint64_t)UINT32_MAX) {
-		return DQLITE_ERROR;
-	}
-	rv = init_read(c, &buf, c->request.words * 8);
-	if (rv != 0) {
-		conn_trace(c, "init read failed %d", rv);
-		return rv;
-	}
-	if (c->request.words == 0) {
-		return 0;
-	}
-	rv = transport__read(&c->transport, &buf, read_request_cb);
-	if (rv != 0) {
-		conn_trace(c, "transport read failed %d", rv);
-		return rv;
-	}
-	return 0;
-}
+static int read_next(struct conn *c);
 
-static void read_message_cb(struct transport *transport, int status)
+static void read_cb(struct transport *transport, int status)
 {
 	struct conn *c = transport->data;
-	struct cursor cursor;
 	int rv;
 
 	if (status != 0) {
@@ -198,31 +304,58 @@ static void read_message_cb(struct transport *transport, int status)
 		return;
 	}
 
-	cursor.p = buffer__cursor(&c->read, 0);
-	cursor.cap = buffer__offset(&c->read);
+	c->read_len += transport->read_n;
 
-	rv = message__decode(&cursor, &c->request);
-	dqlite_assert(rv == 0); /* Can't fail, we know we have enough bytes */
-
-	rv = read_request(c);
+	rv = read_next(c);
 	if (rv != 0) {
-		conn_trace(c, "read request error %d", rv);
+		conn_trace(c, "read next error %d", rv);
 		conn__stop(c);
 		return;
 	}
 }
 
-/* Start reading metadata about the next message */
-static int read_message(struct conn *c)
+/* Dispatch the next request if it has been fully received already, or start
+ * reading the missing part of it. */
+static int read_next(struct conn *c)
 {
+	size_t header = message__sizeof(&c->request);
+	size_t need = header;
+	size_t size;
+	struct cursor cursor;
+	char *base;
 	uv_buf_t buf;
 	int rv;
-	rv = init_read(c, &buf, message__sizeof(&c->request));
-	if (rv != 0) {
-		conn_trace(c, "init read failed %d", rv);
-		return rv;
+
+	if (c->read_len >= header) {
+		cursor.p = buffer__cursor(&c->read, 0);
+		cursor.cap = header;
+		rv = message__decode(&cursor, &c->request);
+		dqlite_assert(rv == 0); /* Can't fail, we have enough bytes */
+		if (UINT64_C(8) * (uint64_t)c->request.words >
+		    (uint64_t)UINT32_MAX) {
+			return DQLITE_ERROR;
+		}
+		need = header + c->request.words * 8;
+		if (c->read_len >= need) {
+			c->read_pos = need;
+			handle_request(c);
+			return 0;
+		}
+	}
+
+	size = need;
+	if (c->read_ahead && size < CONN_READ_AHEAD) {
+		size = CONN_READ_AHEAD;
+	}
+	buffer__reset(&c->read);
+	base = buffer__advance(&c->read, size);
+	if (base == NULL) {
+		return DQLITE_NOMEM;
 	}
-	rv = transport__read(&c->transport, &buf, read_message_cb);
+	buf.base = base + c->read_len;
+	buf.len = size - c->read_len;
+	rv = transport__read_at_least(&c->transport, &buf, need - c->read_len,
+				      read_cb);
 	if (rv != 0) {
 		conn_trace(c, "transport read failed %d", rv);
 		return rv;
@@ -230,10 +363,27 @@ static int read_message(struct conn *c)
 	return 0;
 }
 
+/* Start handling the next request, discarding the previous one. */
+static int read_message(struct conn *c)
+{
+	size_t n = c->read_len - c->read_pos;
+	char *base = buffer__cursor(&c->read, 0);
+
+	/* Keep any data that was read past the previous request. */
+	if (n > 0 && c->read_pos > 0) {
+		memmove(base, base + c->read_pos, n);
+	}
+	c->read_len = n;
+	c->read_pos = 0;
+
+	return read_next(c);
+}
+
 static void read_protocol_cb(struct transport *transport, int status)
 {
 	struct conn *c = transport->data;
 	struct cursor cursor;
+	uint64_t features = 0;
 	int rv;
 
 	if (status != 0) {
@@ -248,6 +398,11 @@ static void read_protocol_cb(struct transport *transport, int status)
 	rv = uint64__decode(&cursor, &c->protocol);
 	dqlite_assert(rv == 0); /* Can't fail, we know we have enough bytes */
 
+	if (c->protocol != DQLITE_PROTOCOL_VERSION_LEGACY) {
+		features = c->protocol & DQLITE_PROTOCOL_FEATURES_MASK;
+		c->protocol &= ~DQLITE_PROTOCOL_FEATURES_MASK;
+	}
+
 	if (c->protocol != DQLITE_PROTOCOL_VERSION &&
 	    c->protocol != DQLITE_PROTOCOL_VERSION_LEGACY) {
 		/* errorf(c->logger, "unknown protocol version: %lx", */
@@ -258,6 +413,16 @@ static void read_protocol_cb(struct transport *transport, int status)
 		goto abort;
 	}
 	c->gateway.protocol = c->protocol;
+	c->read_len = 0;
+	c->read_pos = 0;
+
+	if (features & CONN_FEATURES & DQLITE_PROTOCOL_FEATURE_LZ4) {
+		rv = buffer__init(&c->compressed);
+		if (rv != 0) {
+			goto abort;
+		}
+		c->features |= DQLITE_PROTOCOL_FEATURE_LZ4;
+	}
 
 	rv = read_message(c);
 	if (rv != 0) {
@@ -292,6 +457,7 @@ int conn__start(struct conn *c,
 		struct uv_loop_s *loop,
 		struct registry *registry,
 		struct raft *raft,
+		pool_t *pool,
 		struct uv_stream_s *stream,
 		struct raft_uv_transport *uv_transport,
 		conn_close_cb close_cb)
@@ -308,7 +474,7 @@ int conn__start(struct conn *c,
 	c->transport.data = c;
 	c->uv_transport = uv_transport;
 	c->close_cb = close_cb;
-	gateway__init(&c->gateway, config, registry, raft);
+	gateway__init(&c->gateway, config, registry, raft, pool);
 	rv = buffer__init(&c->read);
 	if (rv != 0) {
 		goto err_after_transport_init;
@@ -320,6 +486,10 @@ int conn__start(struct conn *c,
 	c->handle = (struct handle) {
 		.data = c,
 	};
+	c->features = 0;
+	c->read_len = 0;
+	c->read_pos = 0;
+	c->read_ahead = false;
 	c->closed = false;
 	/* First, we expect the client to send us the protocol version. */
 	rv = read_protocol(c);
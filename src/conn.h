@@ -28,7 +28,12 @@ struct conn
 	struct gateway gateway;                 /* Request handler */
 	struct buffer read;                     /* Read buffer */
 	struct buffer write;                    /* Write buffer */
+	struct buffer compressed;               /* Compressed write buffer */
 	uint64_t protocol;                      /* Protocol format version */
+	uint64_t features;                      /* Negotiated features */
+	size_t read_len;                        /* Bytes received in read */
+	size_t read_pos;                        /* End of current request */
+	bool read_ahead;                        /* Read past request ends */
 	struct message request;                 /* Request message meta data */
 	struct message response;                /* Response message meta data */
 	struct handle handle;
@@ -47,6 +52,7 @@ int conn__start(struct conn *c,
 		struct uv_loop_s *loop,
 		struct registry *registry,
 		struct raft *raft,
+		pool_t *pool,
 		struct uv_stream_s *stream,
 		struct raft_uv_transport *uv_transport,
 		conn_close_cb close_cb);
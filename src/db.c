@@ -7,16 +7,17 @@
 #include "db.h"
 #include "lib/assert.h"
 #include "tracing.h"
+#include "vfs.h"
 
 /* Limit taken from sqlite unix vfs. */
 #define MAX_PATHNAME 512
 
-static uint32_t str_hash(const char* name)
+uint32_t db__hash(const char *filename)
 {
 	const unsigned char *p;
 	uint32_t h = 5381U;
 
-	for (p = (const unsigned char *) name; *p != '\0'; p++) {
+	for (p = (const unsigned char *) filename; *p != '\0'; p++) {
 		h = (h << 5) + h + *p;
 	}
 
@@ -42,7 +43,7 @@ int db__init(struct db *db, struct config *config, const char *filename)
 		.config = config,
 		.vfs = vfs,
 		.filename = db_filename,
-		.cookie = str_hash(filename),
+		.cookie = db__hash(filename),
 	};
 	queue_init(&db->pending_queue);
 	return DQLITE_OK;
@@ -51,9 +52,24 @@ int db__init(struct db *db, struct config *config, const char *filename)
 void db__close(struct db *db)
 {
 	dqlite_assert(db->leaders == 0);
+	while (db->n_idle > 0) {
+		sqlite3_close(db->idle[--db->n_idle]);
+	}
+	db__discard_tx(db);
 	sqlite3_free(db->filename);
 }
 
+void db__discard_tx(struct db *db)
+{
+	for (uint32_t i = 0; i < db->tx.n_pages; i++) {
+		sqlite3_free(db->tx.pages[i]);
+	}
+	sqlite3_free(db->tx.pages);
+	sqlite3_free(db->tx.page_numbers);
+	db->tx = (struct vfsTransaction){};
+	db->tx_id = 0;
+}
+
 int db__open(struct db *db, sqlite3 **out)
 {
 	tracef("open conn: %s page_size:%u", db->filename, db->config->vfs.page_size);
@@ -69,3 +85,35 @@ int db__open(struct db *db, sqlite3 **out)
 	*out = conn;
 	return SQLITE_OK;
 }
+
+int db__acquire(struct db *db, sqlite3 **conn)
+{
+	if (db->n_idle > 0) {
+		*conn = db->idle[--db->n_idle];
+		return SQLITE_OK;
+	}
+	return db__open(db, conn);
+}
+
+void db__release(struct db *db, sqlite3 *conn, bool reuse)
+{
+	if (VfsDeleted(conn)) {
+		/* The database goes away with its last connection, don't keep
+		 * any of them around. */
+		while (db->n_idle > 0) {
+			sqlite3_close(db->idle[--db->n_idle]);
+		}
+		reuse = false;
+	}
+
+	if (!reuse || db->n_idle == DB_IDLE_MAX ||
+	    sqlite3_txn_state(conn, NULL) != SQLITE_TXN_NONE ||
+	    sqlite3_next_stmt(conn, NULL) != NULL) {
+		int rv = sqlite3_close_v2(conn);
+		dqlite_assert(rv == SQLITE_OK);
+		return;
+	}
+
+	sqlite3_progress_handler(conn, 0, NULL, NULL);
+	db->idle[db->n_idle++] = conn;
+}
@@ -5,12 +5,16 @@
 #ifndef DB_H_
 #define DB_H_
 
+#include <stdbool.h>
 #include <stdint.h>
 #include "lib/queue.h"
 
 #include "config.h"
 #include "raft.h"
 
+/* Maximum number of idle connections kept open for reuse. */
+#define DB_IDLE_MAX 4
+
 struct db
 {
 	struct config *config;        /* Dqlite configuration */
@@ -22,6 +26,12 @@ struct db
 	struct leader *active_leader; /* Current leader writing to the database */
 	queue pending_queue;          /* Queue of pending execs, used by leader */
 	queue queue;                  /* Prev/next database, used by the registry */
+	struct db *next;              /* Next database in the same registry bucket */
+	bool dirty;                   /* Written to since the last snapshot */
+	sqlite3 *idle[DB_IDLE_MAX];   /* Open connections ready for reuse */
+	unsigned n_idle;              /* Number of idle connections */
+	uint64_t tx_id;               /* Transaction being received in chunks */
+	struct vfsTransaction tx;     /* Pages received so far for tx_id */
 };
 
 /**
@@ -35,14 +45,39 @@ int db__init(struct db *db, struct config *config, const char *filename);
 /**
  * Release all memory associated with a database object.
  *
- * If the follower connection was opened, it will be closed.
+ * Idle connections are closed.
  */
 void db__close(struct db *db);
 
+/**
+ * Hash a database filename, the result is used as the database cookie.
+ */
+uint32_t db__hash(const char *filename);
+
 /**
  * Open a connection to the database.
  */
 int db__open(struct db *db, sqlite3 **conn);
 
+/**
+ * Get a connection to the database, reusing an idle one if possible.
+ */
+int db__acquire(struct db *db, sqlite3 **conn);
+
+/**
+ * Give back a connection obtained with db__acquire.
+ *
+ * The connection is kept for reuse if @reuse is true and it holds no
+ * transaction nor statement, otherwise it is closed. Closing the last
+ * connection of a deleted database frees @db through the registry, so @db
+ * must not be used after this call.
+ */
+void db__release(struct db *db, sqlite3 *conn, bool reuse);
+
+/**
+ * Drop the pages of a partially received transaction, if any.
+ */
+void db__discard_tx(struct db *db);
+
 
 #endif /* DB_H_*/
@@ -14,6 +14,7 @@
 #include "vfs.h"
 
 struct fsmDatabaseSnapshot {
+	struct db *db;
 	sqlite3 *conn;
 	struct raft_buffer header;
 	struct vfsSnapshot content;
@@ -29,8 +30,12 @@ struct fsm {
 	struct logger *logger;
 	struct registry *registry;
 	struct fsmSnapshot snapshot;
+	uint64_t partial_term; /* Lowest term of a partial transaction, or 0 */
 };
 
+/* Leaders set the upper 32 bits of the transaction ID to their term. */
+#define TX_TERM(TX_ID) ((TX_ID) >> 32)
+
 /* Not used */
 static int apply_open(struct fsm *f, const struct command_open *c)
 {
@@ -40,16 +45,146 @@ static int apply_open(struct fsm *f, const struct command_open *c)
 	return 0;
 }
 
+/* Drop the partial transactions started by the leaders of terms older than
+ * the one of @tx_id. Entries are applied in log order, so all the chunks of
+ * those transactions that made it to the log have been applied already. */
+static void discardStaleTransactions(struct fsm *f, uint64_t tx_id)
+{
+	uint64_t term = TX_TERM(tx_id);
+	uint64_t partial_term = 0;
+	queue *head;
+
+	if (f->partial_term == 0 || term <= f->partial_term) {
+		return;
+	}
+	QUEUE_FOREACH(head, &f->registry->dbs)
+	{
+		struct db *db = QUEUE_DATA(head, struct db, queue);
+		if (db->tx_id == 0) {
+			continue;
+		}
+		if (TX_TERM(db->tx_id) < term) {
+			tracef("discard stale transaction %" PRIu64, db->tx_id);
+			db__discard_tx(db);
+			continue;
+		}
+		if (partial_term == 0 || TX_TERM(db->tx_id) < partial_term) {
+			partial_term = TX_TERM(db->tx_id);
+		}
+	}
+	f->partial_term = partial_term;
+}
+
+/* Copy the pages of a non-final chunk of a transaction. On failure the
+ * transaction is marked as broken by leaving db->tx.pages NULL, so that its
+ * final chunk is not applied without the pages of this one. */
+static int receiveChunk(struct fsm *f,
+			struct db *db,
+			const struct command_frames *c)
+{
+	uint32_t n = db->tx.n_pages + c->frames.n_pages;
+	uint64_t *page_numbers;
+	void **pages;
+
+	if (db->tx_id == c->tx_id && db->tx.pages == NULL) {
+		/* An earlier chunk was lost already. */
+		return 0;
+	}
+	db->tx_id = c->tx_id;
+	if (f->partial_term == 0 || TX_TERM(c->tx_id) < f->partial_term) {
+		f->partial_term = TX_TERM(c->tx_id);
+	}
+
+	page_numbers =
+	    sqlite3_realloc64(db->tx.page_numbers, n * sizeof *page_numbers);
+	if (page_numbers == NULL) {
+		goto oom;
+	}
+	db->tx.page_numbers = page_numbers;
+	pages = sqlite3_realloc64(db->tx.pages, n * sizeof *pages);
+	if (pages == NULL) {
+		goto oom;
+	}
+	db->tx.pages = pages;
+
+	for (uint32_t i = 0; i < c->frames.n_pages; i++) {
+		void *page = sqlite3_malloc(c->frames.page_size);
+		if (page == NULL) {
+			goto oom;
+		}
+		memcpy(page, c->frames.pages[i], c->frames.page_size);
+		page_numbers[db->tx.n_pages] = c->frames.page_numbers[i];
+		pages[db->tx.n_pages] = page;
+		db->tx.n_pages++;
+	}
+	return 0;
+
+oom:
+	db__discard_tx(db);
+	db->tx_id = c->tx_id;
+	return RAFT_NOMEM;
+}
+
 static int apply_frames(struct fsm *f, const struct command_frames *c)
 {
 	tracef("fsm apply frames");
 	struct db *db;
+	uint64_t *page_numbers = NULL;
+	void **pages = NULL;
 	int rv;
 
 	rv = registry__get_or_create(f->registry, c->filename, &db);
 	if (rv != 0) {
 		tracef("db get failed %d", rv);
-		return rv;
+		goto out;
+	}
+
+	discardStaleTransactions(f, c->tx_id);
+	if (db->tx_id != c->tx_id) {
+		/* The leader gave up on the previous transaction. */
+		db__discard_tx(db);
+	}
+
+	if (!c->is_commit) {
+		/* Without a transaction ID this must be an upgrade from V1,
+		 * which is not supported anymore. */
+		rv = c->tx_id != 0 ? receiveChunk(f, db, c) : DQLITE_PROTO;
+		goto out;
+	}
+
+	struct vfsTransaction transaction = {
+		.n_pages = c->frames.n_pages,
+		.page_numbers = c->frames.page_numbers,
+		.pages = c->frames.pages,
+	};
+
+	if (db->tx_id != 0) {
+		/* Final chunk: apply it along with the previous ones. */
+		if (db->tx.pages == NULL) {
+			db__discard_tx(db);
+			rv = RAFT_NOMEM;
+			goto out;
+		}
+		uint32_t n = db->tx.n_pages + c->frames.n_pages;
+		page_numbers = sqlite3_malloc64(n * sizeof *page_numbers);
+		pages = sqlite3_malloc64(n * sizeof *pages);
+		if (page_numbers == NULL || pages == NULL) {
+			db__discard_tx(db);
+			rv = RAFT_NOMEM;
+			goto out;
+		}
+		memcpy(page_numbers, db->tx.page_numbers,
+		       db->tx.n_pages * sizeof *page_numbers);
+		memcpy(pages, db->tx.pages, db->tx.n_pages * sizeof *pages);
+		memcpy(page_numbers + db->tx.n_pages, c->frames.page_numbers,
+		       c->frames.n_pages * sizeof *page_numbers);
+		memcpy(pages + db->tx.n_pages, c->frames.pages,
+		       c->frames.n_pages * sizeof *pages);
+		transaction = (struct vfsTransaction){
+			.n_pages = n,
+			.page_numbers = page_numbers,
+			.pages = pages,
+		};
 	}
 
 	sqlite3 *conn = NULL;
@@ -58,36 +193,30 @@ static int apply_frames(struct fsm *f, const struct command_frames *c)
 		conn = db->active_leader->conn;
 	} else {
 		/* Follower transaction */
-		rv = db__open(db, &conn);
+		rv = db__acquire(db, &conn);
 		if (rv != 0) {
 			tracef("open follower failed %d", rv);
-			return rv;
+			db__discard_tx(db);
+			goto out;
 		}
 	}
 
-	/* The commit marker must be set as otherwise this must be an
-	 * upgrade from V1, which is not supported anymore. */
-	if (!c->is_commit) {
-		rv = DQLITE_PROTO;
-		goto error;
-	}
-
-	struct vfsTransaction transaction = {
-		.n_pages = c->frames.n_pages,
-		.page_numbers = c->frames.page_numbers,
-		.pages = c->frames.pages,
-	};
 	rv = VfsApply(conn, &transaction);
 	if (rv != 0) {
 		tracef("VfsApply failed %d", rv);
 		rv = rv == SQLITE_BUSY ? RAFT_BUSY : RAFT_IOERR;
-		goto error;
+	} else {
+		db->dirty = true;
 	}
+	db__discard_tx(db);
 
-error:
 	if (db->active_leader == NULL) {
-		sqlite3_close(conn);
+		db__release(db, conn, true);
 	}
+
+out:
+	sqlite3_free(page_numbers);
+	sqlite3_free(pages);
 	sqlite3_free(c->frames.page_numbers);
 	sqlite3_free(c->frames.pages);
 	return rv;
@@ -311,11 +440,12 @@ static int restoreDatabase(struct registry *r,
 	}
 
 	sqlite3 *conn;
-	rv = db__open(db, &conn);
+	rv = db__acquire(db, &conn);
 	if (rv != SQLITE_OK) {
 		return rv == SQLITE_NOMEM ? RAFT_NOMEM : RAFT_ERROR;
 	}
 	rv = VfsRestore(conn, snapshot);
+	db->dirty = true;
 
 	if (rv == SQLITE_OK) {
 		bool check_passed = true;
@@ -330,7 +460,7 @@ static int restoreDatabase(struct registry *r,
 		}
 	}
 
-	sqlite3_close(conn);
+	db__release(db, conn, true);
 	if (rv != SQLITE_OK) {
 		if (rv == SQLITE_CORRUPT) {
 			return RAFT_CORRUPT;
@@ -346,7 +476,8 @@ static int restoreDatabase(struct registry *r,
 
 static int snapshotDatabase(struct db *db, struct fsmDatabaseSnapshot *snapshot)
 {
-	int rv = db__open(db, &snapshot->conn);
+	snapshot->db = db;
+	int rv = db__acquire(db, &snapshot->conn);
 	if (rv == SQLITE_NOMEM) {
 		return RAFT_NOMEM;
 	}
@@ -354,17 +485,26 @@ static int snapshotDatabase(struct db *db, struct fsmDatabaseSnapshot *snapshot)
 		return RAFT_ERROR;
 	}
 
-	rv = VfsCheckpoint(snapshot->conn);
-	if (rv == SQLITE_BUSY) {
-		tracef("checkpoint: busy reader or writer");
-	} else if (rv != SQLITE_OK) {
-		tracef("checkpoint failed: %d", rv);
+	/* A database that wasn't written since it was last checkpointed here
+	 * has an empty WAL, so there's nothing to fold into the main file. */
+	if (db->dirty) {
+		rv = VfsCheckpoint(snapshot->conn);
+		if (rv == SQLITE_OK) {
+			db->dirty = false;
+		} else if (rv == SQLITE_BUSY) {
+			tracef("checkpoint: busy reader or writer");
+		} else {
+			tracef("checkpoint failed: %d", rv);
+			db__release(db, snapshot->conn, true);
+			snapshot->conn = NULL;
+			return rv == SQLITE_NOMEM ? RAFT_NOMEM : RAFT_ERROR;
+		}
 	}
 
 	rv = VfsAcquireSnapshot(snapshot->conn, &snapshot->content);
 	/* I think this can be an assert. */
 	if (rv != SQLITE_OK) {
-		sqlite3_close(snapshot->conn);
+		db__release(db, snapshot->conn, true);
 		if (rv == SQLITE_NOMEM) {
 			return RAFT_NOMEM;
 		}
@@ -382,7 +522,7 @@ static int snapshotDatabase(struct db *db, struct fsmDatabaseSnapshot *snapshot)
 	void *header_buffer = raft_malloc(header_size);
 	if (header_buffer == NULL) {
 		VfsReleaseSnapshot(snapshot->conn, &snapshot->content);
-		sqlite3_close(snapshot->conn);
+		db__release(db, snapshot->conn, true);
 		return RAFT_NOMEM;
 	}
 	char *cursor = header_buffer;
@@ -396,6 +536,19 @@ static int snapshotDatabase(struct db *db, struct fsmDatabaseSnapshot *snapshot)
 	return RAFT_OK;
 }
 
+static bool hasPartialTransactions(struct fsm *f)
+{
+	queue *head;
+	QUEUE_FOREACH(head, &f->registry->dbs)
+	{
+		struct db *db = QUEUE_DATA(head, struct db, queue);
+		if (db->tx_id != 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
 static int fsm__snapshot(struct raft_fsm *fsm,
 			 struct raft_buffer *bufs[],
 			 unsigned *n_bufs)
@@ -410,6 +563,15 @@ static int fsm__snapshot(struct raft_fsm *fsm,
 	PRE(f->snapshot.header.len == 0 && f->snapshot.header.base == NULL);
 	PRE(f->snapshot.database_count == 0 && f->snapshot.databases == NULL);
 
+	/* The pages of a partially received transaction are not part of the
+	 * databases yet, so wait until it's complete. */
+	if (f->partial_term != 0) {
+		if (hasPartialTransactions(f)) {
+			return RAFT_BUSY;
+		}
+		f->partial_term = 0;
+	}
+
 	const size_t database_count = registry__size(f->registry);
 
 	struct raft_buffer header;
@@ -485,7 +647,7 @@ err:
 			raft_free(databases[i].header.base);
 			VfsReleaseSnapshot(databases[i].conn,
 					   &databases[i].content);
-			sqlite3_close(databases[i].conn);
+			db__release(databases[i].db, databases[i].conn, true);
 		}
 	}
 	raft_free(databases);
@@ -511,7 +673,8 @@ static int fsm__snapshot_finalize(struct raft_fsm *fsm,
 			raft_free(f->snapshot.databases[i].header.base);
 			VfsReleaseSnapshot(f->snapshot.databases[i].conn,
 					   &f->snapshot.databases[i].content);
-			sqlite3_close(f->snapshot.databases[i].conn);
+			db__release(f->snapshot.databases[i].db,
+				    f->snapshot.databases[i].conn, true);
 		}
 	}
 	raft_free(f->snapshot.databases);
@@ -540,6 +703,14 @@ static int fsm__restore(struct raft_fsm *fsm, struct raft_buffer *buf)
 		return RAFT_MALFORMED;
 	}
 
+	/* The snapshot was taken with no partial transaction around. */
+	queue *head;
+	QUEUE_FOREACH(head, &f->registry->dbs)
+	{
+		db__discard_tx(QUEUE_DATA(head, struct db, queue));
+	}
+	f->partial_term = 0;
+
 	for (i = 0; i < header.n; i++) {
 		struct vfsSnapshot snapshot;
 		const char *filename;
@@ -35,13 +35,15 @@ static void interrupt(struct gateway *g);
 void gateway__init(struct gateway *g,
 		   struct config *config,
 		   struct registry *registry,
-		   struct raft *raft)
+		   struct raft *raft,
+		   pool_t *pool)
 {
 	tracef("gateway init");
 	*g = (struct gateway){
 		.config = config,
 		.registry = registry,
 		.raft = raft,
+		.pool = pool,
 		.protocol = DQLITE_PROTOCOL_VERSION,
 	};
 	stmt__registry_init(&g->stmts);
@@ -484,10 +486,22 @@ static void fill_result(struct gateway *g, struct response_result *response)
 	response->rows_affected = (uint64_t)sqlite3_changes(g->leader->conn);
 }
 
-static int exec_work(struct raft_io_async_work *work)
+/* Run the given SQLite work for the current request on the thread pool. All
+ * work for the same database is affined to the same pool thread. */
+static void gateway_queue_work(struct gateway *g,
+			       void (*work_cb)(pool_work_t *w),
+			       void (*after_work_cb)(pool_work_t *w))
 {
-	struct exec *exec = work->data;
-	struct gateway *g = exec->data;
+	PRE(g->leader != NULL && g->leader->exec != NULL);
+	g->work = (pool_work_t){};
+	pool_queue_work(g->pool, &g->work, g->leader->db->cookie, WT_UNORD,
+			work_cb, after_work_cb);
+}
+
+static void exec_work(pool_work_t *w)
+{
+	struct gateway *g = CONTAINER_OF(w, struct gateway, work);
+	struct exec *exec = g->leader->exec;
 	struct handle *req = g->req;
 
 	int rv = bind__params(exec->stmt, &req->decoder);
@@ -499,29 +513,19 @@ static int exec_work(struct raft_io_async_work *work)
 		leader_exec_result(exec,
 				   rv == SQLITE_DONE ? RAFT_OK : RAFT_ERROR);
 	}
-
-	return RAFT_OK;
 }
 
-static void exec_work_done(struct raft_io_async_work *req, int status)
+static void exec_work_done(pool_work_t *w)
 {
-	dqlite_assert(status == RAFT_OK);
-	return leader_exec_resume(req->data);
+	struct gateway *g = CONTAINER_OF(w, struct gateway, work);
+	return leader_exec_resume(g->leader->exec);
 }
 
 static void handle_exec_work_cb(struct exec *exec)
 {
 	PRE(exec->stmt != NULL);
 	struct gateway *g = exec->data;
-	g->work = (struct raft_io_async_work){
-		.data = exec,
-		.work = exec_work,
-	};
-	int rv = g->raft->io->async_work(g->raft->io, &g->work, exec_work_done);
-	if (rv != RAFT_OK) {
-		leader_exec_result(exec, rv);
-		return leader_exec_resume(exec);
-	}
+	gateway_queue_work(g, exec_work, exec_work_done);
 }
 
 static void handle_exec_done_cb(struct exec *exec)
@@ -685,10 +689,19 @@ static int handle_exec_sql(struct gateway *g, struct handle *req)
 	return 0;
 }
 
-static int query_work(struct raft_io_async_work *work)
+/* Return the schema of the ROWS responses for the given query request. */
+static uint8_t rows_schema(const struct handle *req)
 {
-	struct exec *exec = work->data;
-	struct gateway *g = exec->data;
+	if (req->schema == DQLITE_REQUEST_QUERY_SCHEMA_COLUMNAR) {
+		return DQLITE_RESPONSE_ROWS_SCHEMA_V1;
+	}
+	return DQLITE_RESPONSE_ROWS_SCHEMA_V0;
+}
+
+static void query_work(pool_work_t *w)
+{
+	struct gateway *g = CONTAINER_OF(w, struct gateway, work);
+	struct exec *exec = g->leader->exec;
 	struct handle *req = g->req;
 
 	int rv;
@@ -697,25 +710,33 @@ static int query_work(struct raft_io_async_work *work)
 		rv = bind__params(exec->stmt, &req->decoder);
 		if (rv != DQLITE_OK) {
 			leader_exec_result(exec, RAFT_GATEWAY_PARSE);
-			return SQLITE_ERROR;
+			w->rc = SQLITE_ERROR;
+			return;
 		}
 		if (tuple_decoder__remaining(&req->decoder) > 0) {
 			leader_exec_result(exec, RAFT_GATEWAY_PARSE);
-			return SQLITE_ERROR;
+			w->rc = SQLITE_ERROR;
+			return;
 		}
 		/* FIXME(marco6): Should I check if all bindings were consumed?
 		 * And moreover, should I allow parameters altogether in this case? */
 		req->parameters_bound = true;
 	}
 
-	return query__batch(exec->stmt, req->buffer);
+	if (req->schema == DQLITE_REQUEST_QUERY_SCHEMA_COLUMNAR) {
+		w->rc = query__batch_columnar(exec->stmt, req->buffer,
+					      &req->row_pending);
+		return;
+	}
+	w->rc = query__batch(exec->stmt, req->buffer);
 }
 
-static void query_work_done(struct raft_io_async_work *work, int rc)
+static void query_work_done(pool_work_t *w)
 {
-	struct exec *exec = work->data;
-	struct gateway *g = exec->data;
+	struct gateway *g = CONTAINER_OF(w, struct gateway, work);
+	struct exec *exec = g->leader->exec;
 	struct handle *req = g->req;
+	int rc = w->rc;
 
 	if (req->cancellation_requested) {
 		/* Nothing else to do. */
@@ -731,7 +752,7 @@ static void query_work_done(struct raft_io_async_work *work, int rc)
 		struct response_rows response = {
 			.eof = DQLITE_RESPONSE_ROWS_PART,
 		};
-		SUCCESS(rows, ROWS, response, 0);
+		SUCCESS(rows, ROWS, response, rows_schema(req));
 		return;
 	}
 
@@ -739,6 +760,66 @@ static void query_work_done(struct raft_io_async_work *work, int rc)
 	return leader_exec_resume(exec);
 }
 
+/* Number of SQLite virtual machine instructions between two checks of the
+ * budget of a query running inline. */
+#define QUERY_INLINE_PERIOD 100
+
+struct query_budget {
+	unsigned remaining; /* Checks left before the budget is exhausted */
+	bool exceeded;      /* Whether the query was interrupted */
+};
+
+static int query_budget_cb(void *arg)
+{
+	struct query_budget *budget = arg;
+	if (budget->remaining == 0) {
+		budget->exceeded = true;
+		return 1;
+	}
+	budget->remaining--;
+	return 0;
+}
+
+/* Try to produce the first batch of a read-only query directly on the loop
+ * thread, saving the round trip to the thread pool for cheap statements.
+ *
+ * If the query exceeds its budget it's interrupted and rewound: no row has
+ * been sent yet and interrupting a read-only statement doesn't roll back the
+ * transaction, so the pool can simply run it again from the start. Return
+ * false in that case, or if the query is not eligible. */
+static bool query_inline(struct gateway *g, struct exec *exec)
+{
+	struct handle *req = g->req;
+	sqlite3 *conn = g->leader->conn;
+	size_t offset = buffer__offset(req->buffer);
+	struct query_budget budget = {
+		.remaining = g->config->query_inline_budget / QUERY_INLINE_PERIOD,
+		.exceeded = false,
+	};
+
+	if (g->config->query_inline_budget == 0 || req->parameters_bound ||
+	    g->leader->close_cb != NULL || !sqlite3_stmt_readonly(exec->stmt)) {
+		return false;
+	}
+
+	g->work = (pool_work_t){};
+	sqlite3_progress_handler(conn, QUERY_INLINE_PERIOD, query_budget_cb,
+				 &budget);
+	query_work(&g->work);
+	sqlite3_progress_handler(conn, 0, NULL, NULL);
+
+	if (budget.exceeded) {
+		tracef("query exceeded inline budget");
+		sqlite3_reset(exec->stmt);
+		buffer__truncate(req->buffer, offset);
+		req->row_pending = false;
+		return false;
+	}
+
+	query_work_done(&g->work);
+	return true;
+}
+
 static void handle_query_work_cb(struct exec *exec)
 {
 	struct gateway *g = exec->data;
@@ -758,15 +839,10 @@ static void handle_query_work_cb(struct exec *exec)
 
 	exec->tail = NULL;
 
-	g->work = (struct raft_io_async_work){
-		.data = exec,
-		.work = query_work,
-	};
-	int rv = g->raft->io->async_work(g->raft->io, &g->work, query_work_done);
-	if (rv != RAFT_OK) {
-		leader_exec_result(exec, rv);
-		return leader_exec_resume(exec);
+	if (query_inline(g, exec)) {
+		return;
 	}
+	gateway_queue_work(g, query_work, query_work_done);
 }
 
 static void handle_query_done_cb(struct exec *exec)
@@ -798,7 +874,7 @@ static void handle_query_done_cb(struct exec *exec)
 	struct response_rows response = {
 		.eof = DQLITE_RESPONSE_ROWS_DONE,
 	};
-	SUCCESS(rows, ROWS, response, 0);
+	SUCCESS(rows, ROWS, response, rows_schema(req));
 
 done:
 	sqlite3_clear_bindings(stmt);
@@ -814,13 +890,15 @@ static int handle_query(struct gateway *g, struct handle *req)
 	int rv;
 
 	if (!IN(req->schema, DQLITE_REQUEST_PARAMS_SCHEMA_V0,
-		DQLITE_REQUEST_PARAMS_SCHEMA_V1)) {
+		DQLITE_REQUEST_PARAMS_SCHEMA_V1,
+		DQLITE_REQUEST_QUERY_SCHEMA_COLUMNAR)) {
 		tracef("bad schema version %d", req->schema);
 		failure(req, SQLITE_ERROR, "unrecognized schema version");
 		return 0;
 	}
 	/* The only difference in layout between the v0 and v1 requests is in
-	 * the tuple, which isn't parsed until bind__params later on. */
+	 * the tuple, which isn't parsed until bind__params later on. The
+	 * columnar schema uses the v1 tuple layout. */
 	rv = request_query__decode(cursor, &request);
 	if (rv != 0) {
 		return rv;
@@ -894,7 +972,7 @@ static void handle_query_sql_done_cb(struct exec *exec)
 	struct response_rows response = {
 		.eof = DQLITE_RESPONSE_ROWS_DONE,
 	};
-	SUCCESS(rows, ROWS, response, 0);
+	SUCCESS(rows, ROWS, response, rows_schema(req));
 
 done:
 	sqlite3_finalize(stmt);
@@ -909,12 +987,14 @@ static int handle_query_sql(struct gateway *g, struct handle *req)
 
 	/* Fail early if the schema version isn't recognized. */
 	if (!IN(req->schema, DQLITE_REQUEST_PARAMS_SCHEMA_V0,
-		DQLITE_REQUEST_PARAMS_SCHEMA_V1)) {
+		DQLITE_REQUEST_PARAMS_SCHEMA_V1,
+		DQLITE_REQUEST_QUERY_SCHEMA_COLUMNAR)) {
 		tracef("bad schema version %d", req->schema);
 		failure(req, SQLITE_ERROR, "unrecognized schema version");
 		return 0;
 	}
-	/* Schema version only affect the tuple format, which is parsed later */
+	/* Schema version only affect the tuple format, which is parsed later,
+	 * and the format of the rows in the response. */
 	rv = request_query_sql__decode(cursor, &request);
 	if (rv != 0) {
 		return rv;
@@ -1096,12 +1176,28 @@ static int handle_remove(struct gateway *g, struct handle *req)
 	return 0;
 }
 
-static int dumpFile(const char *filename,
-		     const struct vfsSnapshot *file,
-		     struct buffer *buffer)
+/* Maximum number of database pages sent by a single write when streaming a
+ * DUMP response. Smaller databases are copied into the response buffer. */
+#define DUMP_CHUNK_PAGES 256
+
+/* State of a DUMP response whose main file is streamed directly from the
+ * pages of a database snapshot. */
+struct dump {
+	struct db *db;               /* Database being dumped */
+	sqlite3 *conn;               /* Connection holding the snapshot */
+	struct vfsSnapshot snapshot; /* Pages of the main file */
+	size_t next;                 /* Index of the next page to send */
+	bool done;                   /* Whether the last chunk was returned */
+	size_t trailer_len;          /* Size of the encoded WAL file entry */
+	char trailer[1024 + 8];      /* Encoded WAL file entry */
+	uv_buf_t bufs[DUMP_CHUNK_PAGES + 1]; /* Chunk being written */
+};
+
+static int dumpFileHeader(const char *filename,
+			  uint64_t len,
+			  struct buffer *buffer)
 {
 	char *cur;
-	uint64_t len = file->page_count * file->page_size;
 
 	cur = buffer__advance(buffer, text__sizeof(&filename));
 	if (cur == NULL) {
@@ -1114,6 +1210,22 @@ static int dumpFile(const char *filename,
 	}
 	uint64__encode(&len, &cur);
 
+	return DQLITE_OK;
+}
+
+static int dumpFile(const char *filename,
+		     const struct vfsSnapshot *file,
+		     struct buffer *buffer)
+{
+	char *cur;
+	uint64_t len = file->page_count * file->page_size;
+	int rv;
+
+	rv = dumpFileHeader(filename, len, buffer);
+	if (rv != DQLITE_OK) {
+		return rv;
+	}
+
 	if (len == 0) {
 		return DQLITE_OK;
 	}
@@ -1133,6 +1245,114 @@ static int dumpFile(const char *filename,
 	return DQLITE_OK;
 }
 
+/* Start streaming the main file of a DUMP response. Only the header of the
+ * main file is written to the response buffer, its pages and the (empty) WAL
+ * file entry are returned by gateway__stream. On success the dump takes
+ * ownership of the connection and of the snapshot. */
+static int dumpStart(struct gateway *g,
+		     struct handle *req,
+		     const char *filename,
+		     const char *wal_filename,
+		     struct db *db,
+		     sqlite3 *conn,
+		     const struct vfsSnapshot *snapshot)
+{
+	struct dump *dump;
+	uint64_t len = snapshot->page_count * snapshot->page_size;
+	uint64_t empty = 0;
+	char *cur;
+	int rv;
+
+	dqlite_assert(g->dump == NULL);
+	dqlite_assert(len % 8 == 0);
+
+	dump = sqlite3_malloc(sizeof *dump);
+	if (dump == NULL) {
+		return DQLITE_NOMEM;
+	}
+	dump->db = db;
+	dump->conn = conn;
+	dump->snapshot = *snapshot;
+	dump->next = 0;
+	dump->done = false;
+	dump->trailer_len =
+	    text__sizeof(&wal_filename) + uint64__sizeof(&empty);
+	dqlite_assert(dump->trailer_len <= sizeof dump->trailer);
+	cur = dump->trailer;
+	text__encode(&wal_filename, &cur);
+	uint64__encode(&empty, &cur);
+
+	/* The size of the whole response must fit the message header. */
+	if ((buffer__offset(req->buffer) + text__sizeof(&filename) +
+	     uint64__sizeof(&len) + len + dump->trailer_len) /
+		8 >
+	    UINT32_MAX) {
+		rv = DQLITE_ERROR;
+		goto err;
+	}
+
+	rv = dumpFileHeader(filename, len, req->buffer);
+	if (rv != DQLITE_OK) {
+		goto err;
+	}
+
+	req->stream_len = len + dump->trailer_len;
+	g->dump = dump;
+	return DQLITE_OK;
+
+err:
+	sqlite3_free(dump);
+	return rv;
+}
+
+void gateway__stream(struct gateway *g, uv_buf_t **bufs, unsigned *n)
+{
+	struct dump *dump = g->dump;
+	unsigned i = 0;
+
+	if (dump == NULL) {
+		*n = 0;
+		return;
+	}
+
+	if (dump->done) {
+		gateway__stream_end(g);
+		*n = 0;
+		return;
+	}
+
+	while (dump->next < dump->snapshot.page_count &&
+	       i < DUMP_CHUNK_PAGES) {
+		dump->bufs[i].base = dump->snapshot.pages[dump->next];
+		dump->bufs[i].len = dump->snapshot.page_size;
+		dump->next++;
+		i++;
+	}
+	if (dump->next == dump->snapshot.page_count) {
+		dump->bufs[i].base = dump->trailer;
+		dump->bufs[i].len = dump->trailer_len;
+		dump->done = true;
+		i++;
+	}
+
+	*bufs = dump->bufs;
+	*n = i;
+}
+
+void gateway__stream_end(struct gateway *g)
+{
+	struct dump *dump = g->dump;
+
+	if (dump == NULL) {
+		return;
+	}
+	tracef("dump stream end");
+	VfsReleaseSnapshot(dump->conn, &dump->snapshot);
+	db__release(dump->db, dump->conn, true);
+	sqlite3_free(dump);
+	g->dump = NULL;
+}
+
 static int handle_dump(struct gateway *g, struct handle *req)
 {
 	tracef("handle dump");
@@ -1148,7 +1368,7 @@ static int handle_dump(struct gateway *g, struct handle *req)
 	}
 
 	sqlite3 *conn;
-	int rv = db__open(db, &conn);
+	int rv = db__acquire(db, &conn);
 	if (rv != SQLITE_OK) {
 		failure(req, rv, "failed to open database");
 		return DQLITE_OK;
@@ -1158,15 +1378,38 @@ static int handle_dump(struct gateway *g, struct handle *req)
 	rv = VfsAcquireSnapshot(conn, &snapshot);
 	if (rv != SQLITE_OK) {
 		failure(req, rv, "failed to open database");
-		sqlite3_close(conn);
+		db__release(db, conn, true);
 		return DQLITE_OK;
 	}
 
+	/* filename is zero inited and initially we allow only writing 1024 - 4
+	 * - 1 bytes to it, so after strncpy filename will be zero-terminated
+	 * and will not have overflowed. strcat adds the 4 byte suffix and
+	 * also zero terminates the resulting string. */
+	const char *wal_suffix = "-wal";
+	strncpy(filename, request.filename,
+		sizeof(filename) - strlen(wal_suffix) - 1);
+	strcat(filename, wal_suffix);
+
 	response.n = 2;
 	cur = buffer__advance(req->buffer, response_files__sizeof(&response));
 	dqlite_assert(cur != NULL);
 	response_files__encode(&response, &cur);
 
+	/* Large databases are streamed straight from the snapshot pages, which
+	 * are then kept alive until the last chunk has been written. */
+	if (snapshot.page_count > DUMP_CHUNK_PAGES) {
+		rv = dumpStart(g, req, request.filename, filename, db, conn,
+			       &snapshot);
+		if (rv != 0) {
+			tracef("main dump failed");
+			failure(req, rv, "failed to dump main database file");
+			goto out_free_data;
+		}
+		req->cb(req, 0, DQLITE_RESPONSE_FILES, 0);
+		return DQLITE_OK;
+	}
+
 	rv = dumpFile(request.filename, &snapshot, req->buffer);
 	if (rv != 0) {
 		tracef("main dump failed");
@@ -1174,14 +1417,6 @@ static int handle_dump(struct gateway *g, struct handle *req)
 		goto out_free_data;
 	}
 
-	/* filename is zero inited and initially we allow only writing 1024 - 4
-	 * - 1 bytes to it, so after strncpy filename will be zero-terminated
-	 * and will not have overflowed. strcat adds the 4 byte suffix and
-	 * also zero terminates the resulting string. */
-	const char *wal_suffix = "-wal";
-	strncpy(filename, request.filename,
-		sizeof(filename) - strlen(wal_suffix) - 1);
-	strcat(filename, wal_suffix);
 	static const struct vfsSnapshot empty_wal = {}; 
 	rv = dumpFile(filename, &empty_wal, req->buffer);
 	if (rv != 0) {
@@ -1194,7 +1429,7 @@ static int handle_dump(struct gateway *g, struct handle *req)
 
 out_free_data:
 	VfsReleaseSnapshot(conn, &snapshot);
-	sqlite3_close(conn);
+	db__release(db, conn, true);
 	return DQLITE_OK;
 }
 
@@ -1396,8 +1631,9 @@ handle:
 	req->db_id = 0;
 	req->cancellation_requested = false;
 	req->parameters_bound = 0;
+	req->row_pending = false;
+	req->stream_len = 0;
 	req->cb = cb;
-	req->work = (pool_work_t){};
 
 	switch (type) {
 #define DISPATCH(LOWER, UPPER, _)            \
@@ -1425,7 +1661,6 @@ int gateway__resume(struct gateway *g, bool *finished)
 	tracef("gateway resume - not finished");
 	*finished = false;
 
-	g->req->work = (pool_work_t){};
 	handle_query_work_cb(g->leader->exec);
 	return 0;
 }
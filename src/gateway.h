@@ -19,6 +19,7 @@
 
 struct handle;
 struct gateway;
+struct dump;
 
 typedef void (*gateway_close_cb)(struct gateway *g);
 
@@ -32,17 +33,20 @@ struct gateway {
 	struct raft *raft;              /* Raft instance */
 	struct leader *leader;          /* Leader connection to the database */
 	struct handle *req;             /* Asynchronous request being handled */
-	struct raft_io_async_work work; /* Work request for off-the-loop execution */
+	pool_t *pool;                   /* Pool running SQLite work */
+	pool_work_t work;               /* Work request for off-the-loop execution */
 	struct stmt__registry stmts;    /* Registry of prepared statements */
 	uint64_t protocol;              /* Protocol format version */
 	uint64_t client_id;
 	gateway_close_cb close_cb;   /* Callback to close the gateway */
+	struct dump *dump;           /* DUMP response being streamed */
 };
 
 void gateway__init(struct gateway *g,
 		   struct config *config,
 		   struct registry *registry,
-		   struct raft *raft);
+		   struct raft *raft,
+		   pool_t *pool);
 
 void gateway__close(struct gateway *g, gateway_close_cb cb);
 
@@ -77,13 +81,17 @@ struct handle {
 	bool cancellation_requested;
 	/* Set to true when the parameters for the current query have been bound */
 	bool parameters_bound;
+	/* Set to true when a columnar query stopped on a row that still has
+	 * to be encoded. */
+	bool row_pending;
+	/* Number of response bytes that follow the ones written to the
+	 * buffer, to be obtained with gateway__stream. */
+	uint64_t stream_len;
 	/* Tuple decoder for the parameters in this request. */
 	struct tuple_decoder decoder;
 	/* Callback that will be invoked at the end of request processing to
 	 * write the response. */
 	handle_cb cb;
-	/* A link into thread pool's queues. */
-	pool_work_t work;
 };
 
 /**
@@ -110,4 +118,18 @@ int gateway__handle(struct gateway *g,
  */
 int gateway__resume(struct gateway *g, bool *finished);
 
+/**
+ * Get the next chunk of a response whose tail is streamed rather than written
+ * to the response buffer (i.e. the request's stream_len is non-zero). The
+ * returned buffers remain valid until the next call. Once the response is
+ * complete @n is set to 0 and the streaming state is released.
+ */
+void gateway__stream(struct gateway *g, uv_buf_t **bufs, unsigned *n);
+
+/**
+ * Abort the response being streamed, if any. Must not be called while a
+ * chunk returned by gateway__stream is still being written.
+ */
+void gateway__stream_end(struct gateway *g);
+
 #endif /* DQLITE_GATEWAY_H_ */
@@ -28,6 +28,7 @@ static void exec_timer_cb(struct raft_timer *timer);
 static bool is_db_full(sqlite3 *conn, unsigned nframes);
 
 static struct exec *exec_dequeue(struct db *db);
+static void exec_resume_dequeued(struct exec *req);
 static void exec_enqueue(struct db *db, struct exec *exec);
 
 static int progress_abort(void *db) {
@@ -52,12 +53,46 @@ static bool exec_needs_barrier(struct leader *l)
 	return l->db->read_index > raft_last_applied(l->raft);
 }
 
+/* Connections are reused across clients, so anything that leaves state behind
+ * on the connection itself rather than in the database makes it unfit for
+ * that. */
+static int leader_authorize(void *arg,
+			    int action,
+			    const char *arg1,
+			    const char *arg2,
+			    const char *db_name,
+			    const char *trigger)
+{
+	struct leader *l = arg;
+	int rv;
+
+	rv = VfsAuthorizer(NULL, action, arg1, arg2, db_name, trigger);
+	if (rv != SQLITE_OK) {
+		return rv;
+	}
+
+	switch (action) {
+		case SQLITE_PRAGMA:
+		case SQLITE_ATTACH:
+		case SQLITE_DETACH:
+		case SQLITE_CREATE_TEMP_INDEX:
+		case SQLITE_CREATE_TEMP_TABLE:
+		case SQLITE_CREATE_TEMP_TRIGGER:
+		case SQLITE_CREATE_TEMP_VIEW:
+			l->tainted = true;
+			break;
+		default:
+			break;
+	}
+	return SQLITE_OK;
+}
+
 int leader__init(struct leader *l, struct db *db, struct raft *raft)
 {
 	tracef("leader init");
 	int rc;
 	sqlite3 *conn;
-	rc = db__open(db, &conn);
+	rc = db__acquire(db, &conn);
 	if (rc != 0) {
 		tracef("open failed %d", rc);
 		return rc;
@@ -68,6 +103,7 @@ int leader__init(struct leader *l, struct db *db, struct raft *raft)
 		.conn = conn,
 		.raft = raft,
 	};
+	sqlite3_set_authorizer(conn, leader_authorize, l);
 	queue_init(&l->queue);
 	db->leaders++;
 	return 0;
@@ -91,11 +127,16 @@ static struct exec *leader_finalize(struct leader *leader)
 
 	struct exec *next = exec_dequeue(leader->db);
 
-	sqlite3_progress_handler(leader->conn, 1, progress_abort, NULL);
-	int rc = sqlite3_close_v2(leader->conn);
-	dqlite_assert(rc == 0);
-
+	/* The close callback finalizes the statements prepared by the owner
+	 * of the leader and may free it, so the connection can only be handed
+	 * back afterwards. */
+	struct db *db = leader->db;
+	sqlite3 *conn = leader->conn;
+	bool reuse = !leader->tainted;
+	sqlite3_progress_handler(conn, 1, progress_abort, NULL);
+	sqlite3_set_authorizer(conn, VfsAuthorizer, NULL);
 	leader->close_cb(leader);
+	db__release(db, conn, reuse);
 
 	return  next;
 }
@@ -112,11 +153,7 @@ void leader__close(struct leader *leader, leader_close_cb close_cb)
 		if (req == NULL) {
 			return;
 		}
-
-		struct db *db = req->leader->db;
-		PRE(IN(db->active_leader, NULL, req->leader));
-		db->active_leader = req->leader;
-		return exec_tick(req);
+		return exec_resume_dequeued(req);
 	} else {
 		/* Abort all queries as soon as possible. */
 		sqlite3_progress_handler(leader->conn, 1, progress_abort, NULL);
@@ -291,50 +328,108 @@ void leader_exec_resume(struct exec *req)
 	return exec_tick(req);
 }
 
-static int exec_apply(struct exec *req, const struct vfsTransaction *transaction)
+static void exec_apply_chunk_cb(struct raft_apply *apply, int status)
 {
-	tracef("leader apply frames");
-	PRE(req != NULL);
-	PRE(transaction->n_pages > 0);
-	PRE(transaction->page_numbers != NULL);
-	PRE(transaction->pages != NULL);
+	(void)status;
+	raft_free(apply);
+}
 
+/* Submit the pages in [@first, @first + @n) of the transaction as a single
+ * raft entry. Only the last chunk has the commit marker set and completes
+ * @req, the others are tracked by their own apply request. */
+static int exec_apply_chunk(struct exec *req,
+			    const struct vfsTransaction *transaction,
+			    uint64_t tx_id,
+			    uint32_t first,
+			    uint32_t n)
+{
 	struct leader *leader = req->leader;
 	struct db *db = leader->db;
+	bool is_commit = first + n == transaction->n_pages;
+	struct raft_apply *apply = &req->apply;
+	raft_apply_cb cb = exec_apply_cb;
 	struct raft_buffer buf;
-
-	if (is_db_full(req->leader->conn, transaction->n_pages)) {
-		return SQLITE_FULL;
-	}
+	int rv;
 
 	const struct command_frames c = {
 		.filename = db->filename,
-		.tx_id = 0,
+		.tx_id = tx_id,
 		.truncate = 0,
-		.is_commit = 1,
+		.is_commit = is_commit,
 		.frames = {
-			.n_pages = (uint32_t)transaction->n_pages,
+			.n_pages = n,
 			.page_size = (uint16_t)db->config->vfs.page_size,
-			.page_numbers = transaction->page_numbers,
-			.pages = transaction->pages,
+			.page_numbers = transaction->page_numbers + first,
+			.pages = transaction->pages + first,
 		}
 	};
-	int rv = command__encode(COMMAND_FRAMES, &c, &buf);
+	rv = command__encode_frames(&c, db->config->frames_compression, &buf);
 	if (rv != 0) {
 		tracef("encode %d", rv);
 		return rv;
 	}
 
-	rv = raft_apply(leader->raft, &req->apply, &buf, 1, exec_apply_cb);
+	if (!is_commit) {
+		apply = raft_malloc(sizeof *apply);
+		if (apply == NULL) {
+			raft_free(buf.base);
+			return RAFT_NOMEM;
+		}
+		cb = exec_apply_chunk_cb;
+	}
+
+	rv = raft_apply(leader->raft, apply, &buf, 1, cb);
 	if (rv != 0) {
 		tracef("raft apply failed %d", rv);
 		raft_free(buf.base);
+		if (!is_commit) {
+			raft_free(apply);
+		}
 		return rv;
 	}
 
 	return 0;
 }
 
+static int exec_apply(struct exec *req, const struct vfsTransaction *transaction)
+{
+	tracef("leader apply frames");
+	PRE(req != NULL);
+	PRE(transaction->n_pages > 0);
+	PRE(transaction->page_numbers != NULL);
+	PRE(transaction->pages != NULL);
+
+	struct leader *leader = req->leader;
+	struct config *config = leader->db->config;
+	uint32_t chunk = transaction->n_pages;
+	uint64_t tx_id;
+	int rv;
+
+	if (is_db_full(req->leader->conn, transaction->n_pages)) {
+		return SQLITE_FULL;
+	}
+
+	if (config->tx_chunk_size > 0) {
+		chunk = (uint32_t)max(
+		    config->tx_chunk_size / config->vfs.page_size, 1);
+	}
+
+	/* Followers use the ID to match the chunks of a transaction, and its
+	 * term to tell when one was abandoned by a former leader. */
+	tx_id = (leader->raft->current_term << 32) |
+		((raft_last_index(leader->raft) + 1) & 0xffffffff);
+
+	for (uint32_t first = 0; first < transaction->n_pages; first += chunk) {
+		uint32_t n = min(chunk, transaction->n_pages - first);
+		rv = exec_apply_chunk(req, transaction, tx_id, first, n);
+		if (rv != 0) {
+			return rv;
+		}
+	}
+
+	return 0;
+}
+
 static void exec_enqueue(struct db *db, struct exec *req)
 {
 	if (db->active_leader == req->leader) {
@@ -348,23 +443,49 @@ static void exec_enqueue(struct db *db, struct exec *req)
 
 /* exec_dequeue dequeues an executable request from the pending
  * queue of db. A request is considered executable if:
- *  - no leader is holding the database busy;
- *  - the request comes from the leader holding the database busy.*/
+ *  - it was queued behind the previous request of its own leader, which is
+ *    now done. These requests have not looked at the database yet, so they
+ *    must not wait for another leader to release it and are picked first;
+ *  - it waits for the database and no leader is holding the database busy
+ *    or the request comes from the leader holding the database busy. */
 static struct exec *exec_dequeue(struct db *db)
 {
-	if (queue_empty(&db->pending_queue)) {
+	struct exec *next = NULL;
+	queue *head;
+
+	QUEUE_FOREACH(head, &db->pending_queue)
+	{
+		struct exec *req = QUEUE_DATA(head, struct exec, queue);
+		if (sm_state(&req->sm) == EXEC_INITED) {
+			if (req->leader->exec == NULL) {
+				next = req;
+				break;
+			}
+		} else if (next == NULL &&
+			   IN(db->active_leader, NULL, req->leader)) {
+			next = req;
+		}
+	}
+	if (next == NULL) {
 		return NULL;
 	}
+	queue_remove(&next->queue);
+	queue_init(&next->queue);
+	leader_trace(next->leader, "dequeued");
+	return next;
+}
+
+/* Resume a request returned by exec_dequeue. Only requests waiting for the
+ * database make their leader the active one. */
+static void exec_resume_dequeued(struct exec *req)
+{
+	struct db *db = req->leader->db;
 
-	queue *item = queue_head(&db->pending_queue);
-	struct exec *req = QUEUE_DATA(item, struct exec, queue);
-	if (db->active_leader == NULL || db->active_leader == req->leader) {
-		queue_remove(&req->queue);
-		queue_init(&req->queue);
-		leader_trace(req->leader, "dequeued");
-		return req;
+	if (sm_state(&req->sm) != EXEC_INITED) {
+		PRE(IN(db->active_leader, NULL, req->leader));
+		db->active_leader = req->leader;
 	}
-	return NULL;
+	return exec_tick(req);
 }
 
 static bool exec_invariant(const struct sm *sm, int prev)
@@ -597,9 +718,7 @@ static void exec_tick(struct exec *req)
 			}
 
 			if (req != NULL) {
-				PRE(IN(db->active_leader, NULL, req->leader));
-				db->active_leader = req->leader;
-				return exec_tick(req);
+				return exec_resume_dequeued(req);
 			}
 			return;
 		default:
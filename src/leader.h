@@ -31,6 +31,8 @@ struct leader {
 	int             pending;  /* Number of pending requests. */
 	leader_close_cb close_cb; /* Close callback. When not NULL it means that
 				     the leader is closing. */
+	bool            tainted;  /* Connection state changed by the client, it
+				     can't be handed to another one. */
 };
 
 /**
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 
+#include "assert.h"
 #include "buffer.h"
 
 #include "../../include/dqlite.h"
@@ -80,3 +81,9 @@ void buffer__reset(struct buffer *b)
 {
 	b->offset = 0;
 }
+
+void buffer__truncate(struct buffer *b, size_t offset)
+{
+	dqlite_assert(offset <= b->offset);
+	b->offset = offset;
+}
@@ -57,4 +57,9 @@ DQLITE_VISIBLE_TO_TESTS void *buffer__cursor(struct buffer *b, size_t offset);
  */
 DQLITE_VISIBLE_TO_TESTS void buffer__reset(struct buffer *b);
 
+/**
+ * Move the write offset back to @offset, discarding what was written after it.
+ */
+DQLITE_VISIBLE_TO_TESTS void buffer__truncate(struct buffer *b, size_t offset);
+
 #endif /* LIB_BUFFER_H_ */
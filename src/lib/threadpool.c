@@ -79,10 +79,6 @@ static const struct sm_conf planner_states[PS_NR] = {
 static const uintptr_t pool_thread_magic = 0xf344e2;
 static uv_key_t thread_identifier_key;
 
-enum {
-	THREADPOOL_SIZE_MAX = 1024,
-};
-
 typedef struct pool_thread pool_thread_t;
 typedef struct pool_impl pool_impl_t;
 
@@ -533,7 +529,7 @@ int pool_init(pool_t *pool,
 	int rc;
 	pool_impl_t *pi = pool->pi;
 
-	PRE(threads_nr <= THREADPOOL_SIZE_MAX);
+	PRE(threads_nr <= POOL_THREADS_MAX);
 
 	pool->flags = 0x0;
 	pi = pool->pi = calloc(1, sizeof(*pool->pi));
@@ -77,6 +77,10 @@ enum {
 	POOL_QOS_PRIO_FAIR = 2,
 };
 
+enum {
+	POOL_THREADS_MAX = 1024, /* Maximum number of threads in a pool */
+};
+
 enum pool_half {
 	POOL_TOP_HALF = 0x109,
 	POOL_BOTTOM_HALF = 0xb01103,
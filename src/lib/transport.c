@@ -46,10 +46,11 @@ static void read_cb(uv_stream_t *stream, ssize_t nread, const uv_buf_t *buf)
 		/* Advance the read window */
 		t->read.base += n;
 		t->read.len -= n;
+		t->read_n += n;
 
-		/* If there's more data to read in order to fill the current
-		 * read buffer, just return, we'll be invoked again. */
-		if (t->read.len > 0) {
+		/* If more data is needed in order to complete the current
+		 * read, just return, we'll be invoked again. */
+		if (t->read_n < t->read_min) {
 			return;
 		}
 
@@ -121,6 +122,8 @@ int transport__init(struct transport *t, struct uv_stream_s *stream)
 	t->stream->data = t;
 	t->read.base = NULL;
 	t->read.len = 0;
+	t->read_min = 0;
+	t->read_n = 0;
 	t->write.data = t;
 	t->read_cb = NULL;
 	t->write_cb = NULL;
@@ -146,12 +149,23 @@ void transport__close(struct transport *t, transport_close_cb cb)
 }
 
 int transport__read(struct transport *t, uv_buf_t *buf, transport_read_cb cb)
+{
+	return transport__read_at_least(t, buf, buf->len, cb);
+}
+
+int transport__read_at_least(struct transport *t,
+			     uv_buf_t *buf,
+			     size_t min,
+			     transport_read_cb cb)
 {
 	int rv;
 
 	dqlite_assert(t->read.base == NULL);
 	dqlite_assert(t->read.len == 0);
+	dqlite_assert(min > 0 && min <= buf->len);
 	t->read = *buf;
+	t->read_min = min;
+	t->read_n = 0;
 	t->read_cb = cb;
 	rv = uv_read_start(t->stream, alloc_cb, read_cb);
 	if (rv != 0) {
@@ -172,12 +186,22 @@ static void write_cb(uv_write_t *req, int status)
 }
 
 int transport__write(struct transport *t, uv_buf_t *buf, transport_write_cb cb)
+{
+	return transport__writev(t, buf, 1, cb);
+}
+
+int transport__writev(struct transport *t,
+		      uv_buf_t bufs[],
+		      unsigned n,
+		      transport_write_cb cb)
 {
 	int rv;
 	dqlite_assert(t->write_cb == NULL);
+	dqlite_assert(n > 0);
 	t->write_cb = cb;
-	rv = uv_write(&t->write, t->stream, buf, 1, write_cb);
+	rv = uv_write(&t->write, t->stream, bufs, n, write_cb);
 	if (rv != 0) {
+		t->write_cb = NULL;
 		return rv;
 	}
 	return 0;
@@ -26,6 +26,8 @@ struct transport
 	void *data;                  /* User defined */
 	struct uv_stream_s *stream;  /* Data stream */
 	uv_buf_t read;               /* Read buffer */
+	size_t read_min;             /* Bytes still needed to complete a read */
+	size_t read_n;               /* Bytes read by the last read request */
 	uv_write_t write;            /* Write request */
 	transport_read_cb read_cb;   /* Read callback */
 	transport_write_cb write_cb; /* Write callback */
@@ -48,11 +50,31 @@ void transport__close(struct transport *t, transport_close_cb cb);
  */
 int transport__read(struct transport *t, uv_buf_t *buf, transport_read_cb cb);
 
+/**
+ * Read from the transport file descriptor until at least @min bytes have been
+ * read into the given buffer. Data already available on the socket is read
+ * as well, up to the size of the buffer. When the callback fires, the number
+ * of bytes read is found in the read_n field of the transport.
+ */
+int transport__read_at_least(struct transport *t,
+			     uv_buf_t *buf,
+			     size_t min,
+			     transport_read_cb cb);
+
 /**
  * Write the given buffer to the transport.
  */
 int transport__write(struct transport *t, uv_buf_t *buf, transport_write_cb cb);
 
+/**
+ * Write the given @n buffers to the transport, in order. The buffers must
+ * remain valid until the callback fires.
+ */
+int transport__writev(struct transport *t,
+		      uv_buf_t bufs[],
+		      unsigned n,
+		      transport_write_cb cb);
+
 /* Create an UV stream object from the given fd. */
 int transport__stream(struct uv_loop_s *loop,
 		      int fd,
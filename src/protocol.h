@@ -17,6 +17,15 @@ enum { DQLITE_VOTER, DQLITE_STANDBY, DQLITE_SPARE };
 /* Legacly pre-1.0 version. */
 #define DQLITE_PROTOCOL_VERSION_LEGACY 0x86104dd760433fe5
 
+/* Optional features that a client can ask for by setting them in the upper 32
+ * bits of the protocol version it sends in the handshake. The server enables
+ * the ones it supports and ignores the others. */
+#define DQLITE_PROTOCOL_FEATURES_MASK 0xffffffff00000000
+#define DQLITE_PROTOCOL_FEATURE_LZ4 0x100000000 /* LZ4-compressed responses */
+
+/* Flags for the extra field of a response message header. */
+#define DQLITE_MESSAGE_LZ4 0x1 /* Body is LZ4-compressed */
+
 /* Special value indicating that a batch of rows is over, but there are more. */
 #define DQLITE_RESPONSE_ROWS_PART 0xeeeeeeeeeeeeeeee
 
@@ -60,6 +69,13 @@ enum {
 #define DQLITE_REQUEST_PARAMS_SCHEMA_V0 0 /* One-byte params count */
 #define DQLITE_REQUEST_PARAMS_SCHEMA_V1 1 /* Four-byte params count */
 
+/* These apply to REQUEST_QUERY and REQUEST_QUERY_SQL only. */
+#define DQLITE_REQUEST_QUERY_SCHEMA_COLUMNAR 2 /* V1 params, columnar rows */
+
+/* These apply to RESPONSE_ROWS. */
+#define DQLITE_RESPONSE_ROWS_SCHEMA_V0 0 /* Row-major tuples */
+#define DQLITE_RESPONSE_ROWS_SCHEMA_V1 1 /* Columnar batches */
+
 /* These apply to REQUEST_PREPARE and RESPONSE_STMT. */
 
 /* At most one statement in request, no tail offset in response */
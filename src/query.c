@@ -95,11 +95,11 @@ static int encode_row(sqlite3_stmt *stmt, struct buffer *buffer, int n)
 	return SQLITE_OK;
 }
 
-int query__batch(sqlite3_stmt *stmt, struct buffer *buffer)
+/* Append the column count and the column names to the message. */
+static int encode_columns(sqlite3_stmt *stmt, struct buffer *buffer, int *n)
 {
 	int column_count;
 	char *cursor;
-	int rc;
 
 	column_count = sqlite3_column_count(stmt);
 	if (column_count < 0) {
@@ -122,6 +122,20 @@ int query__batch(sqlite3_stmt *stmt, struct buffer *buffer)
 		text__encode(&name, &cursor);
 	}
 
+	*n = column_count;
+	return SQLITE_OK;
+}
+
+int query__batch(sqlite3_stmt *stmt, struct buffer *buffer)
+{
+	int column_count;
+	int rc;
+
+	rc = encode_columns(stmt, buffer, &column_count);
+	if (rc != SQLITE_OK) {
+		return rc;
+	}
+
 	/* Insert the rows. */
 	do {
 		if (buffer__offset(buffer) >= buffer->page_size) {
@@ -144,3 +158,301 @@ int query__batch(sqlite3_stmt *stmt, struct buffer *buffer)
 
 	return rc;
 }
+
+/* Values of a single column accumulated while building a columnar batch. */
+struct column
+{
+	int type;             /* Type of the non-NULL values, or SQLITE_NULL */
+	struct buffer nulls;  /* NULL bitmap */
+	struct buffer values; /* One 64-bit slot per row */
+	struct buffer data;   /* Payloads of variable size values */
+};
+
+static bool is_variable_size(int type)
+{
+	return type == SQLITE_TEXT || type == SQLITE_BLOB ||
+	       type == DQLITE_ISO8601;
+}
+
+static int column_init(struct column *c)
+{
+	int rc;
+	c->type = SQLITE_NULL;
+	rc = buffer__init(&c->nulls);
+	if (rc != 0) {
+		goto err;
+	}
+	rc = buffer__init(&c->values);
+	if (rc != 0) {
+		goto err_after_nulls_init;
+	}
+	rc = buffer__init(&c->data);
+	if (rc != 0) {
+		goto err_after_values_init;
+	}
+	return 0;
+
+err_after_values_init:
+	buffer__close(&c->values);
+err_after_nulls_init:
+	buffer__close(&c->nulls);
+err:
+	return rc;
+}
+
+static void column_close(struct column *c)
+{
+	buffer__close(&c->data);
+	buffer__close(&c->values);
+	buffer__close(&c->nulls);
+}
+
+/* Append a 64-bit slot to the values of the column. */
+static int column_append_slot(struct column *c, uint64_t slot)
+{
+	char *cursor = buffer__advance(&c->values, sizeof slot);
+	if (cursor == NULL) {
+		return SQLITE_NOMEM;
+	}
+	uint64__encode(&slot, &cursor);
+	return SQLITE_OK;
+}
+
+/* Append the i'th value of the current row, which is the n'th row of the
+ * batch and has the given type. */
+static int column_append(struct column *c,
+			 sqlite3_stmt *stmt,
+			 int i,
+			 int type,
+			 uint64_t n)
+{
+	const void *payload;
+	uint8_t *nulls;
+	uint64_t slot;
+	double real;
+	size_t len;
+	char *cursor;
+	int rc;
+
+	if (n % 8 == 0) {
+		nulls = buffer__advance(&c->nulls, 1);
+		if (nulls == NULL) {
+			return SQLITE_NOMEM;
+		}
+		*nulls = 0;
+	}
+
+	if (type == SQLITE_NULL) {
+		nulls = buffer__cursor(&c->nulls, n / 8);
+		*nulls = (uint8_t)(*nulls | (1 << (n % 8)));
+		/* Slots of leading NULLs are filled once the type is known. */
+		if (c->type == SQLITE_NULL) {
+			return SQLITE_OK;
+		}
+		slot = is_variable_size(c->type) ? buffer__offset(&c->data) : 0;
+		return column_append_slot(c, slot);
+	}
+
+	if (c->type == SQLITE_NULL) {
+		dqlite_assert(buffer__offset(&c->data) == 0);
+		c->type = type;
+		for (uint64_t j = 0; j < n; j++) {
+			rc = column_append_slot(c, 0);
+			if (rc != SQLITE_OK) {
+				return rc;
+			}
+		}
+	}
+	dqlite_assert(c->type == type);
+
+	switch (type) {
+		case SQLITE_INTEGER:
+		case DQLITE_UNIXTIME:
+		case DQLITE_BOOLEAN:
+			slot = (uint64_t)sqlite3_column_int64(stmt, i);
+			break;
+		case SQLITE_FLOAT:
+			real = sqlite3_column_double(stmt, i);
+			memcpy(&slot, &real, sizeof slot);
+			break;
+		case SQLITE_TEXT:
+		case DQLITE_ISO8601:
+		case SQLITE_BLOB:
+			payload = type == SQLITE_BLOB
+				      ? sqlite3_column_blob(stmt, i)
+				      : sqlite3_column_text(stmt, i);
+			len = (size_t)sqlite3_column_bytes(stmt, i);
+			cursor = buffer__advance(&c->data, len);
+			if (cursor == NULL) {
+				return SQLITE_NOMEM;
+			}
+			if (len > 0) {
+				memcpy(cursor, payload, len);
+			}
+			slot = buffer__offset(&c->data);
+			break;
+		default:
+			return SQLITE_ERROR;
+	}
+
+	return column_append_slot(c, slot);
+}
+
+/* Append the values of a column to the message. */
+static int encode_column(struct column *c, struct buffer *buffer)
+{
+	uint64_t type = (uint64_t)c->type;
+	size_t n_nulls = buffer__offset(&c->nulls);
+	size_t n_values = buffer__offset(&c->values);
+	size_t n_data = buffer__offset(&c->data);
+	uint64_t zero = 0;
+	size_t size;
+	char *cursor;
+
+	size = uint64__sizeof(&type) + BytePad64(n_nulls) + n_values;
+	if (is_variable_size(c->type)) {
+		size += uint64__sizeof(&zero) + BytePad64(n_data);
+	}
+
+	cursor = buffer__advance(buffer, size);
+	if (cursor == NULL) {
+		return SQLITE_NOMEM;
+	}
+	memset(cursor, 0, size);
+
+	uint64__encode(&type, &cursor);
+	memcpy(cursor, buffer__cursor(&c->nulls, 0), n_nulls);
+	cursor += BytePad64(n_nulls);
+	if (c->type == SQLITE_NULL) {
+		return SQLITE_OK;
+	}
+	if (is_variable_size(c->type)) {
+		uint64__encode(&zero, &cursor);
+	}
+	memcpy(cursor, buffer__cursor(&c->values, 0), n_values);
+	cursor += n_values;
+	if (is_variable_size(c->type) && n_data > 0) {
+		memcpy(cursor, buffer__cursor(&c->data, 0), n_data);
+	}
+
+	return SQLITE_OK;
+}
+
+int query__batch_columnar(sqlite3_stmt *stmt,
+			  struct buffer *buffer,
+			  bool *pending)
+{
+	struct column *columns;
+	int column_count;
+	uint64_t n = 0;
+	size_t size;
+	char *cursor;
+	int types[16];
+	int *row_types = types;
+	int rc;
+	int i;
+
+	rc = encode_columns(stmt, buffer, &column_count);
+	if (rc != SQLITE_OK) {
+		return rc;
+	}
+
+	columns = sqlite3_malloc64(sizeof *columns * (size_t)column_count);
+	if (column_count > 0 && columns == NULL) {
+		return SQLITE_NOMEM;
+	}
+	if (column_count > (int)(sizeof types / sizeof *types)) {
+		row_types = sqlite3_malloc64(sizeof *row_types *
+					     (size_t)column_count);
+		if (row_types == NULL) {
+			sqlite3_free(columns);
+			return SQLITE_NOMEM;
+		}
+	}
+	for (i = 0; i < column_count; i++) {
+		rc = column_init(&columns[i]);
+		if (rc != 0) {
+			column_count = i;
+			rc = SQLITE_NOMEM;
+			goto out;
+		}
+	}
+
+	/* Accumulate the rows. */
+	size = buffer__offset(buffer);
+	do {
+		if (size >= buffer->page_size) {
+			/* As for query__batch, we break after a memory page
+			 * worth of data, and send more rows in a separate
+			 * response. */
+			rc = SQLITE_ROW;
+			break;
+		}
+		if (*pending) {
+			*pending = false;
+			rc = SQLITE_ROW;
+		} else {
+			rc = sqlite3_step(stmt);
+		}
+		if (rc != SQLITE_ROW) {
+			break;
+		}
+		for (i = 0; i < column_count; i++) {
+			row_types[i] = value_type(stmt, i);
+			if (row_types[i] != SQLITE_NULL &&
+			    columns[i].type != SQLITE_NULL &&
+			    row_types[i] != columns[i].type) {
+				break;
+			}
+		}
+		if (i < column_count) {
+			/* A column changed type, close this batch and start
+			 * the next one from this row. */
+			dqlite_assert(n > 0);
+			*pending = true;
+			rc = SQLITE_ROW;
+			break;
+		}
+		for (i = 0; i < column_count; i++) {
+			size -= buffer__offset(&columns[i].values) +
+				buffer__offset(&columns[i].data);
+			rc = column_append(&columns[i], stmt, i, row_types[i],
+					   n);
+			if (rc != SQLITE_OK) {
+				goto out;
+			}
+			size += buffer__offset(&columns[i].values) +
+				buffer__offset(&columns[i].data);
+		}
+		n++;
+	} while (1);
+
+	if (rc != SQLITE_ROW && rc != SQLITE_DONE) {
+		goto out;
+	}
+
+	/* Insert the batch. */
+	cursor = buffer__advance(buffer, uint64__sizeof(&n));
+	if (cursor == NULL) {
+		rc = SQLITE_NOMEM;
+		goto out;
+	}
+	uint64__encode(&n, &cursor);
+	for (i = 0; i < column_count; i++) {
+		int rv = encode_column(&columns[i], buffer);
+		if (rv != SQLITE_OK) {
+			rc = rv;
+			goto out;
+		}
+	}
+
+out:
+	for (i = 0; i < column_count; i++) {
+		column_close(&columns[i]);
+	}
+	if (row_types != types) {
+		sqlite3_free(row_types);
+	}
+	sqlite3_free(columns);
+	return rc;
+}
@@ -6,6 +6,7 @@
 #define QUERY_H_
 
 #include <sqlite3.h>
+#include <stdbool.h>
 
 #include "lib/buffer.h"
 #include "lib/serialize.h"
@@ -17,4 +18,42 @@
  */
 int query__batch(sqlite3_stmt *stmt, struct buffer *buffer);
 
+/**
+ * Like query__batch, but encode the yielded rows as a single columnar batch.
+ *
+ * After the column count and names, the batch contains:
+ *
+ *  64 bits: Number of rows n in the batch.
+ *
+ * followed by one block per column:
+ *
+ *  64 bits: Type code shared by all non-NULL values of the column in this
+ *           batch, or SQLITE_NULL if all values are NULL.
+ *  n bits:  NULL bitmap, least significant bit first, padded to a full
+ *           64-bit word. A set bit means the value is NULL.
+ *
+ * and then, depending on the column type:
+ *
+ *  - SQLITE_INTEGER, DQLITE_UNIXTIME, DQLITE_BOOLEAN: n signed 64-bit
+ *    integers.
+ *  - SQLITE_FLOAT: n 64-bit IEEE 754 doubles.
+ *  - SQLITE_TEXT, DQLITE_ISO8601, SQLITE_BLOB: n + 1 unsigned 64-bit offsets,
+ *    the first being 0, followed by the concatenated payloads (without NUL
+ *    terminators), padded to a full 64-bit word. The i'th value spans the
+ *    bytes between the i'th and the (i+1)'th offsets.
+ *  - SQLITE_NULL: nothing.
+ *
+ * Slots of NULL values are zero for fixed-size types and empty for variable
+ * size ones.
+ *
+ * A batch only holds values of a single type per column: when a row yields a
+ * value whose type differs from the one of its column, the batch is closed
+ * without that row and @pending is set to true, so that the next call starts
+ * a new batch from the row the statement is positioned on instead of stepping
+ * it.
+ */
+int query__batch_columnar(sqlite3_stmt *stmt,
+			  struct buffer *buffer,
+			  bool *pending);
+
 #endif /* QUERY_H_*/
@@ -1031,8 +1031,14 @@ struct raft {
 	 * user-supplied callbacks. */
 	uint64_t callbacks;
 
+	/* Limit the entries sent in a single AppendEntries message, and the
+	 * number of messages in flight to a follower in pipeline mode. */
+	unsigned max_append_entries;
+	unsigned pipeline_window;
+	uint64_t max_append_entries_size;
+
 	/* Future extensions */
-	uint64_t reserved[31];
+	uint64_t reserved[29];
 };
 
 RAFT_API int raft_init(struct raft *r,
@@ -1171,6 +1177,25 @@ RAFT_API void raft_set_max_catch_up_rounds(struct raft *r, unsigned n);
 RAFT_API void raft_set_max_catch_up_round_duration(struct raft *r,
 						   unsigned msecs);
 
+/**
+ * Set the maximum number of entries and the maximum total size of their
+ * payloads that a leader sends in a single AppendEntries message. A message
+ * always carries at least one entry, if there's any to send. Zero means no
+ * limit, which is the default for both.
+ */
+RAFT_API void raft_set_max_append_entries(struct raft *r,
+					  unsigned n,
+					  size_t size);
+
+/**
+ * Set the maximum number of AppendEntries messages carrying entries that a
+ * leader keeps in flight to a follower in pipeline mode. Once the window is
+ * full only heartbeats are sent until the follower acknowledges some of them.
+ * When set, the leader also fills the window right away when a follower is
+ * lagging behind. The default is zero, meaning no limit.
+ */
+RAFT_API void raft_set_pipeline_window(struct raft *r, unsigned n);
+
 /**
  * Return a human-readable description of the last error occurred.
  */
@@ -1542,6 +1567,29 @@ RAFT_API void raft_uv_set_block_size(struct raft_io *io, size_t size);
  */
 RAFT_API void raft_uv_set_segment_size(struct raft_io *io, size_t size);
 
+/**
+ * Set the maximum number of writes against the current open segment that can
+ * be in flight at the same time.
+ *
+ * With a value greater than one, new append requests are written while the
+ * previous ones are still in progress, instead of waiting for them and being
+ * batched into the next write. Append callbacks still fire in log order.
+ *
+ * The default is 1. Passing 0 is equivalent to passing 1.
+ */
+RAFT_API void raft_uv_set_max_concurrent_writes(struct raft_io *io,
+						unsigned n);
+
+/**
+ * Enable or disable writing open segments through io_uring.
+ *
+ * When enabled, io_uring is used if the kernel supports it, otherwise KAIO is
+ * used, falling back to the threadpool when writes would block.
+ *
+ * The default is true.
+ */
+RAFT_API void raft_uv_set_io_uring(struct raft_io *io, bool enabled);
+
 /**
  * Turn snapshot compression on or off.
  * Returns non-0 on failure, this can e.g. happen when compression is requested
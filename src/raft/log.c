@@ -769,6 +769,17 @@ int logAcquire(struct raft_log *l,
 	       struct raft_entry *entries[],
 	       unsigned *n)
 {
+	return logAcquireAtMost(l, index, 0, 0, entries, n);
+}
+
+int logAcquireAtMost(struct raft_log *l,
+		     const raft_index index,
+		     const unsigned max_n,
+		     const size_t max_size,
+		     struct raft_entry *entries[],
+		     unsigned *n)
+{
+	size_t size = 0;
 	size_t i;
 	size_t j;
 
@@ -800,6 +811,19 @@ int logAcquire(struct raft_log *l,
 
 	dqlite_assert(*n > 0);
 
+	if (max_n > 0 && *n > max_n) {
+		*n = max_n;
+	}
+	if (max_size > 0) {
+		for (j = 0; j < *n; j++) {
+			size += l->entries[(i + j) % l->size].buf.len;
+			if (size >= max_size) {
+				*n = (unsigned)j + 1;
+				break;
+			}
+		}
+	}
+
 	*entries = raft_calloc(*n, sizeof **entries);
 	if (*entries == NULL) {
 		return RAFT_NOMEM;
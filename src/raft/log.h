@@ -166,6 +166,16 @@ int logAcquire(struct raft_log *l,
 	       struct raft_entry *entries[],
 	       unsigned *n);
 
+/* Like logAcquire(), but stop after @max_n entries or once the total size of
+ * their payloads reaches @max_size, whichever comes first. At least one entry
+ * is acquired if there's any. Zero means no limit. */
+int logAcquireAtMost(struct raft_log *l,
+		     raft_index index,
+		     unsigned max_n,
+		     size_t max_size,
+		     struct raft_entry *entries[],
+		     unsigned *n);
+
 /* Release a previously acquired array of entries. */
 void logRelease(struct raft_log *l,
 		raft_index index,
@@ -16,6 +16,7 @@ static void initProgress(struct raft_progress *p, raft_index last_index)
 	p->recent_recv = false;
 	p->state = PROGRESS__PROBE;
 	p->features = 0;
+	p->in_flight = 0;
 }
 
 int progressBuildArray(struct raft *r)
@@ -137,8 +138,11 @@ bool progressShouldReplicate(struct raft *r, unsigned i)
 		case PROGRESS__PIPELINE:
 			/* In replication mode we send empty append entries
 			 * messages only if haven't sent anything in the last
-			 * heartbeat interval. */
-			result = !progressIsUpToDate(r, i) || needs_heartbeat;
+			 * heartbeat interval, and new entries only if the
+			 * pipeline window is not full. */
+			result = (!progressIsUpToDate(r, i) &&
+				  !progressWindowIsFull(r, i)) ||
+				 needs_heartbeat;
 			break;
 	}
 	return result;
@@ -299,12 +303,35 @@ void progressToProbe(struct raft *r, const unsigned i)
 		p->next_index = p->match_index + 1;
 	}
 	p->state = PROGRESS__PROBE;
+	p->in_flight = 0;
 }
 
 void progressToPipeline(struct raft *r, const unsigned i)
 {
 	struct raft_progress *p = &r->leader_state.progress[i];
 	p->state = PROGRESS__PIPELINE;
+	p->in_flight = 0;
+}
+
+bool progressWindowIsFull(struct raft *r, const unsigned i)
+{
+	struct raft_progress *p = &r->leader_state.progress[i];
+	return p->state == PROGRESS__PIPELINE && r->pipeline_window > 0 &&
+	       p->in_flight >= r->pipeline_window;
+}
+
+void progressInFlightSent(struct raft *r, const unsigned i)
+{
+	struct raft_progress *p = &r->leader_state.progress[i];
+	p->in_flight++;
+}
+
+void progressInFlightAcked(struct raft *r, const unsigned i)
+{
+	struct raft_progress *p = &r->leader_state.progress[i];
+	if (p->in_flight > 0) {
+		p->in_flight--;
+	}
 }
 
 bool progressSnapshotDone(struct raft *r, const unsigned i)
@@ -28,6 +28,7 @@ struct raft_progress
 	    snapshot_last_send; /* Timestamp of last InstallSnaphot RPC. */
 	bool recent_recv;    /* A msg was received within election timeout. */
 	raft_flags features; /* What the server is capable of. */
+	unsigned in_flight;  /* AppendEntries with entries not yet answered. */
 };
 
 /* Create and initialize the array of progress objects used by the leader to *
@@ -113,6 +114,19 @@ void progressOptimisticNextIndex(struct raft *r,
 				 unsigned i,
 				 raft_index next_index);
 
+/* Whether as many AppendEntries messages as allowed by the pipeline window are
+ * in flight to the i'th server. */
+bool progressWindowIsFull(struct raft *r, unsigned i);
+
+/* Account for an AppendEntries message carrying entries sent to the i'th
+ * server in pipeline mode. */
+void progressInFlightSent(struct raft *r, unsigned i);
+
+/* Account for a successful AppendEntries result received from the i'th
+ * server. Results don't say which message they answer, so this is only an
+ * estimate, which errs on the side of letting more messages through. */
+void progressInFlightAcked(struct raft *r, unsigned i);
+
 /* Return false if the given @index comes from an outdated message. Otherwise
  * update the progress and returns true. To be called when receiving a
  * successful AppendEntries RPC response. */
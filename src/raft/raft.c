@@ -102,6 +102,9 @@ int raft_init(struct raft *r,
 	r->pre_vote = false;
 	r->max_catch_up_rounds = DEFAULT_MAX_CATCH_UP_ROUNDS;
 	r->max_catch_up_round_duration = DEFAULT_MAX_CATCH_UP_ROUND_DURATION;
+	r->max_append_entries = 0;
+	r->max_append_entries_size = 0;
+	r->pipeline_window = 0;
 	rv = r->io->init(r->io, r->id, r->address);
 	if (rv != 0) {
 		ErrMsgTransfer(r->io->errmsg, r->errmsg, "io");
@@ -196,6 +199,17 @@ void raft_set_max_catch_up_round_duration(struct raft *r, unsigned msecs)
 	r->max_catch_up_round_duration = msecs;
 }
 
+void raft_set_max_append_entries(struct raft *r, unsigned n, size_t size)
+{
+	r->max_append_entries = n;
+	r->max_append_entries_size = size;
+}
+
+void raft_set_pipeline_window(struct raft *r, unsigned n)
+{
+	r->pipeline_window = n;
+}
+
 void raft_set_pre_vote(struct raft *r, bool enabled)
 {
 	r->pre_vote = enabled;
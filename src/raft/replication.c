@@ -72,11 +72,17 @@ static int sendAppendEntries(struct raft *r,
 	args->prev_log_index = prev_index;
 	args->prev_log_term = prev_term;
 
-	/* TODO: implement a limit to the total size of the entries being sent
-	 */
-	rv = logAcquire(r->log, next_index, &args->entries, &args->n_entries);
-	if (rv != 0) {
-		goto err;
+	if (progressWindowIsFull(r, i)) {
+		/* Just a heartbeat. */
+		args->entries = NULL;
+		args->n_entries = 0;
+	} else {
+		rv = logAcquireAtMost(r->log, next_index, r->max_append_entries,
+				      (size_t)r->max_append_entries_size,
+				      &args->entries, &args->n_entries);
+		if (rv != 0) {
+			goto err;
+		}
 	}
 
 	/* From Section 3.5:
@@ -115,9 +121,10 @@ static int sendAppendEntries(struct raft *r,
 		goto err_after_req_alloc;
 	}
 
-	if (progressState(r, i) == PROGRESS__PIPELINE) {
+	if (progressState(r, i) == PROGRESS__PIPELINE && req->n > 0) {
 		/* Optimistically update progress. */
 		progressOptimisticNextIndex(r, i, req->index + req->n);
+		progressInFlightSent(r, i);
 	}
 
 	progressUpdateLastSend(r, i);
@@ -288,6 +295,7 @@ int replicationProgress(struct raft *r, unsigned i)
 	raft_index next_index = progressNextIndex(r, i);
 	raft_index prev_index;
 	raft_term prev_term;
+	int rv;
 
 	dqlite_assert(r->state == RAFT_LEADER);
 	dqlite_assert(server->id != r->id);
@@ -343,7 +351,32 @@ int replicationProgress(struct raft *r, unsigned i)
 		prev_term = logLastTerm(r->log);
 	}
 
-	return sendAppendEntries(r, i, prev_index, prev_term);
+	/* With a full pipeline window only a heartbeat is sent, which must not
+	 * refer to entries that the server might not have received yet. */
+	if (progressWindowIsFull(r, i)) {
+		raft_index match_index = progressMatchIndex(r, i);
+		raft_term match_term = logTermOf(r->log, match_index);
+		if (match_index == 0 || match_term != 0) {
+			prev_index = match_index;
+			prev_term = match_term;
+		}
+	}
+
+	rv = sendAppendEntries(r, i, prev_index, prev_term);
+	if (rv != 0) {
+		return rv;
+	}
+
+	/* Keep streaming entries to a lagging server until the window is
+	 * full. Without a window, the next message is sent when this one is
+	 * acknowledged or new entries are appended. */
+	if (r->pipeline_window > 0 &&
+	    progressState(r, i) == PROGRESS__PIPELINE &&
+	    !progressIsUpToDate(r, i) && !progressWindowIsFull(r, i)) {
+		return replicationProgress(r, i);
+	}
+
+	return 0;
 
 send_snapshot:
 	if (progressGetRecentRecv(r, i)) {
@@ -779,6 +812,7 @@ int replicationUpdate(struct raft *r,
 	 *
 	 *   If successful update nextIndex and matchIndex for follower.
 	 */
+	progressInFlightAcked(r, i);
 	if (!progressMaybeUpdate(r, i, last_index)) {
 		return 0;
 	}
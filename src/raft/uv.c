@@ -98,7 +98,7 @@ static int uvInit(struct raft_io *io, raft_id id, const char *address)
 
 	/* Probe file system capabilities */
 	rv = UvFsProbeCapabilities(uv->dir, &direct_io, &uv->async_io,
-				   &uv->fallocate, io->errmsg);
+				   &uv->uring, &uv->fallocate, io->errmsg);
 	if (rv != 0) {
 		return rv;
 	}
@@ -703,6 +703,8 @@ int raft_uv_init(struct raft_io *io,
 	uv->errored = false;
 	uv->direct_io = false;
 	uv->async_io = false;
+	uv->uring = false;
+	uv->uring_enabled = true;
 	uv->fallocate = false;
 #ifdef LZ4_ENABLED
 	uv->snapshot_compression = true;
@@ -722,6 +724,7 @@ int raft_uv_init(struct raft_io *io,
 	queue_init(&uv->append_segments);
 	queue_init(&uv->append_pending_reqs);
 	queue_init(&uv->append_writing_reqs);
+	uv->append_max_writes = 1;
 	uv->barrier = NULL;
 	queue_init(&uv->finalize_reqs);
 	uv->finalize_work.data = NULL;
@@ -786,6 +789,20 @@ void raft_uv_set_segment_size(struct raft_io *io, size_t size)
 	uv->segment_size = size;
 }
 
+void raft_uv_set_max_concurrent_writes(struct raft_io *io, unsigned n)
+{
+	struct uv *uv;
+	uv = io->impl;
+	uv->append_max_writes = n > 0 ? n : 1;
+}
+
+void raft_uv_set_io_uring(struct raft_io *io, bool enabled)
+{
+	struct uv *uv;
+	uv = io->impl;
+	uv->uring_enabled = enabled;
+}
+
 void raft_uv_set_block_size(struct raft_io *io, size_t size)
 {
 	struct uv *uv;
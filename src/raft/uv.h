@@ -66,6 +66,8 @@ struct uv
 	bool errored;                        /* If a disk I/O error was hit */
 	bool direct_io;                 /* Whether direct I/O is supported */
 	bool async_io;                  /* Whether async I/O is supported */
+	bool uring;                     /* Whether io_uring is supported */
+	bool uring_enabled;             /* Whether to use io_uring if supported */
 	bool fallocate;                 /* Whether fallocate is supported */
 	size_t segment_size;            /* Initial size of open segments. */
 	size_t block_size;              /* Block size of the data dir */
@@ -80,6 +82,7 @@ struct uv
 	queue append_segments;          /* Open segments in use. */
 	queue append_pending_reqs;      /* Pending append requests. */
 	queue append_writing_reqs;      /* Append requests in flight */
+	unsigned append_max_writes;     /* Max concurrent writes per segment */
 	struct UvBarrier *barrier;      /* Inflight barrier request */
 	queue finalize_reqs;            /* Segments waiting to be closed */
 	struct uv_work_s finalize_work; /* Resize and rename segments */
@@ -219,6 +222,14 @@ void uvSegmentBufferFinalize(struct uvSegmentBuffer *b, uv_buf_t *out);
  * be set accordingly. */
 void uvSegmentBufferReset(struct uvSegmentBuffer *b, unsigned retain);
 
+/* Move the data of the buffer @b to @out, so that it can be written while new
+ * entries get encoded in @b.
+ *
+ * As with uvSegmentBufferReset(), if the last block of the data is partially
+ * filled, a copy of it is left at the beginning of @b. The memory previously
+ * held by @out, if any, is reused for @b. */
+int uvSegmentBufferTake(struct uvSegmentBuffer *b, struct uvSegmentBuffer *out);
+
 /* Write a closed segment, containing just one entry at the given index
  * for the given configuration. */
 int uvSegmentCreateClosedWithConfiguration(
@@ -16,18 +16,26 @@
  *   the entries in the request, then request a new open segment to be prepared,
  *   queue the request and link it to the newly requested segment.
  *
- * - Wait for any pending write against the current segment to complete, and
- *   also for the prepare request if we asked for a new segment. Also wait for
- *   any in progress barrier to be removed.
+ * - Wait for the prepare request if we asked for a new segment, and for
+ *   enough pending writes against the current segment to complete (only one
+ *   write at a time is allowed by default, see below). Also wait for any in
+ *   progress barrier to be removed.
  *
  * - Submit a write request for the entries in this append request. The write
  *   request might contain other append requests targeted to the current segment
  *   that might have accumulated in the meantime, if we have been waiting for a
- *   segment to be prepared, or for the previous write to complete or for a
+ *   segment to be prepared, or for previous writes to complete or for a
  *   barrier to be removed.
  *
- * - Wait for the write request to finish and fire the append request's
- *   callback.
+ * - Wait for the write request, and all the ones submitted before it, to
+ *   finish and fire the append request's callback.
+ *
+ * Writes always cover whole blocks, so a write that ends with a partially
+ * filled block shares it with the next write, which rewrites it with more data.
+ * Concurrent writes to the same block might hit the disk in any order, so when
+ * several writes are allowed to be in flight, the shared block of a write is
+ * submitted separately, only once the previous write has completed, while the
+ * rest of its blocks are submitted right away.
  *
  * Possible failure modes are:
  *
@@ -77,21 +85,42 @@ struct uvAliveSegment
 	struct uv *uv;                  /* Our writer */
 	struct uvPrepare prepare;       /* Prepare segment file request */
 	struct UvWriter writer;         /* Writer to perform async I/O */
-	struct UvWriterReq write;       /* Write request */
 	unsigned long long counter;     /* Open segment counter */
 	raft_index first_index;         /* Index of the first entry written */
 	raft_index pending_last_index;  /* Index of the last entry written */
 	size_t size;                    /* Total number of bytes used */
 	unsigned next_block;            /* Next segment block to write */
 	struct uvSegmentBuffer pending; /* Buffer for data yet to be written */
-	uv_buf_t buf;                   /* Write buffer for current write */
+	struct uvSegmentBuffer spare;   /* Memory of a past write, for reuse */
 	raft_index last_index;          /* Last entry actually written */
 	size_t written;                 /* Number of bytes actually written */
+	queue writes;                   /* Writes in flight, in log order */
+	unsigned n_writes;              /* Number of writes in flight */
+	int status;                     /* Error of the first failed write */
 	queue queue;                    /* Segment queue */
 	struct UvBarrier *barrier;      /* Barrier waiting on this segment */
 	bool finalize;                  /* Finalize the segment after writing */
 };
 
+/* A write of the blocks of an open segment starting at @block. */
+struct uvAliveWrite
+{
+	struct uvAliveSegment *segment; /* Segment being written */
+	struct uvSegmentBuffer data;    /* Data to write */
+	unsigned block;                 /* First block to write */
+	uv_buf_t head;                  /* First block, if written on its own */
+	uv_buf_t body;                  /* The other blocks, or all of them */
+	struct UvWriterReq head_req;    /* Write request for @head */
+	struct UvWriterReq body_req;    /* Write request for @body */
+	bool head_deferred;             /* Head waiting for the previous write */
+	unsigned n_parts;               /* Parts of the write not yet done */
+	int status;                     /* Error of a failed part, if any */
+	unsigned n_reqs;                /* Number of append requests fulfilled */
+	raft_index last_index;          /* Last entry written */
+	size_t written;                 /* Bytes of the segment written after */
+	queue queue;                    /* Segment writes queue */
+};
+
 struct uvAppend
 {
 	struct raft_io_append *req;       /* User request */
@@ -118,6 +147,7 @@ static void uvAliveSegmentWriterCloseCb(struct UvWriter *writer)
 	struct uvAliveSegment *segment = writer->data;
 	struct uv *uv = segment->uv;
 	uvSegmentBufferClose(&segment->pending);
+	uvSegmentBufferClose(&segment->spare);
 	RaftHeapFree(segment);
 	uvMaybeFireCloseCb(uv);
 }
@@ -172,11 +202,19 @@ static void uvAppendFinishRequestsInQueue(struct uv *uv, queue *q, int status)
 	}
 }
 
-/* Flush the append requests in the writing queue, firing their callbacks with
- * the given status. */
-static void uvAppendFinishWritingRequests(struct uv *uv, int status)
+/* Flush the first @n append requests in the writing queue, firing their
+ * callbacks with the given status. */
+static void uvAppendFinishWritingRequests(struct uv *uv, unsigned n, int status)
 {
-	uvAppendFinishRequestsInQueue(uv, &uv->append_writing_reqs, status);
+	queue q;
+	queue_init(&q);
+	for (; n > 0; n--) {
+		queue *head = queue_head(&uv->append_writing_reqs);
+		dqlite_assert(head != &uv->append_writing_reqs);
+		queue_remove(head);
+		queue_insert_tail(&q, head);
+	}
+	uvAppendFinishRequestsInQueue(uv, &q, status);
 }
 
 /* Flush the append requests in the pending queue, firing their callbacks with
@@ -228,81 +266,109 @@ static int uvAliveSegmentEncodeEntriesToWriteBuf(struct uvAliveSegment *segment,
 }
 
 static int uvAppendMaybeStart(struct uv *uv);
-static void uvAliveSegmentWriteCb(struct UvWriterReq *write, const int status)
+
+/* Return the oldest write in flight against the given segment. */
+static struct uvAliveWrite *uvAliveSegmentFirstWrite(struct uvAliveSegment *s)
 {
-	struct uvAliveSegment *s = write->data;
-	struct uv *uv = s->uv;
-	unsigned n_blocks;
-	int rv;
+	if (queue_empty(&s->writes)) {
+		return NULL;
+	}
+	return QUEUE_DATA(queue_head(&s->writes), struct uvAliveWrite, queue);
+}
 
-	dqlite_assert(uv->state != UV__CLOSED);
+/* Return the most recent write in flight against the given segment. */
+static struct uvAliveWrite *uvAliveSegmentLastWrite(struct uvAliveSegment *s)
+{
+	if (queue_empty(&s->writes)) {
+		return NULL;
+	}
+	return QUEUE_DATA(queue_tail(&s->writes), struct uvAliveWrite, queue);
+}
 
-	dqlite_assert(s->buf.len % uv->block_size == 0);
-	dqlite_assert(s->buf.len >= uv->block_size);
+/* Return the write submitted right after the given one, if any. */
+static struct uvAliveWrite *uvAliveWriteNext(struct uvAliveWrite *w)
+{
+	queue *next = queue_next(&w->queue);
+	if (next == &w->segment->writes) {
+		return NULL;
+	}
+	return QUEUE_DATA(next, struct uvAliveWrite, queue);
+}
 
-	/* Check if the write was successful. */
-	if (status != 0) {
-		tracef("write: %s", uv->io->errmsg);
-		uv->errored = true;
-		goto out;
+/* Return #true if a new write can be submitted against the given segment. */
+static bool uvAliveSegmentCanWrite(struct uvAliveSegment *s)
+{
+	struct uvAliveWrite *last = uvAliveSegmentLastWrite(s);
+	if (s->n_writes >= s->uv->append_max_writes) {
+		return false;
+	}
+	/* Don't pile up more writes behind one that is itself waiting. */
+	if (last != NULL && last->head_deferred) {
+		return false;
 	}
+	return true;
+}
 
-	s->written = s->next_block * uv->block_size + s->pending.n;
-	s->last_index = s->pending_last_index;
+static void uvAliveWriteCb(struct UvWriterReq *req, const int status);
 
-	/* Update our write markers.
-	 *
-	 * We have four cases:
-	 *
-	 * - The data fit completely in the leftover space of the first block
-	 * that we wrote and there is more space left. In this case we just keep
-	 * the scheduled marker unchanged.
-	 *
-	 * - The data fit completely in the leftover space of the first block
-	 * that we wrote and there is no space left. In this case we advance the
-	 *   current block counter, reset the first write block and set the
-	 *   scheduled marker to 0.
-	 *
-	 * - The data did not fit completely in the leftover space of the first
-	 *   block that we wrote, so we wrote more than one block. The last
-	 * block that we wrote was not filled completely and has leftover space.
-	 * In this case we advance the current block counter and copy the memory
-	 * used for the last block to the head of the write arena list, updating
-	 * the scheduled marker accordingly.
-	 *
-	 * - The data did not fit completely in the leftover space of the first
-	 *   block that we wrote, so we wrote more than one block. The last
-	 * block that we wrote was filled exactly and has no leftover space. In
-	 * this case we advance the current block counter, reset the first
-	 * buffer and set the scheduled marker to 0.
-	 */
-	n_blocks = (unsigned)(s->buf.len /
-			      uv->block_size); /* Number of blocks written. */
-	if (s->pending.n < uv->block_size) {
-		/* Nothing to do */
-		dqlite_assert(n_blocks == 1);
-	} else if (s->pending.n == uv->block_size) {
-		dqlite_assert(n_blocks == 1);
-		s->next_block++;
-		uvSegmentBufferReset(&s->pending, 0);
-	} else {
-		dqlite_assert(s->pending.n > uv->block_size);
-		dqlite_assert(s->buf.len > uv->block_size);
+/* Submit the first block of the given write, which it shares with the write
+ * before it. */
+static int uvAliveWriteSubmitHead(struct uvAliveWrite *w)
+{
+	struct uvAliveSegment *s = w->segment;
+	dqlite_assert(w->head_deferred);
+	w->head_deferred = false;
+	return UvWriterSubmit(&s->writer, &w->head_req, &w->head, 1,
+			      w->block * s->uv->block_size, uvAliveWriteCb);
+}
 
-		if (s->pending.n % uv->block_size > 0) {
-			s->next_block += n_blocks - 1;
-			uvSegmentBufferReset(&s->pending, n_blocks - 1);
-		} else {
-			s->next_block += n_blocks;
-			uvSegmentBufferReset(&s->pending, 0);
+/* Account for a part of the given write being done. Once all of it is done,
+ * the shared block of the next write can be submitted. */
+static void uvAliveWritePartDone(struct uvAliveWrite *w, int status)
+{
+	struct uvAliveWrite *next;
+	int rv;
+
+	dqlite_assert(w->n_parts > 0);
+	if (status != 0 && w->status == 0) {
+		w->status = status;
+	}
+	w->n_parts--;
+	if (w->n_parts > 0) {
+		return;
+	}
+
+	next = uvAliveWriteNext(w);
+	if (next != NULL && next->head_deferred) {
+		rv = uvAliveWriteSubmitHead(next);
+		if (rv != 0) {
+			uvAliveWritePartDone(next, rv);
 		}
 	}
+}
 
-out:
-	/* Fire the callbacks of all requests that were fulfilled with this
-	 * write. */
-	uvAppendFinishWritingRequests(uv, status);
-	if (status != 0) {
+/* Complete a write whose parts are all done, firing the callbacks of the append
+ * requests that it fulfilled. */
+static void uvAliveWriteFinish(struct uvAliveWrite *w)
+{
+	struct uvAliveSegment *s = w->segment;
+	struct uv *uv = s->uv;
+	queue *head;
+
+	dqlite_assert(w->n_parts == 0);
+	queue_remove(&w->queue);
+	s->n_writes--;
+
+	if (w->status != 0 && s->status == 0) {
+		tracef("write: %s", uv->io->errmsg);
+		uv->errored = true;
+		s->status = w->status;
+		/* The writes submitted after this one are going to be reported
+		 * as failed below as well, regardless of their own outcome. */
+		QUEUE_FOREACH(head, &s->writes)
+		{
+			QUEUE_DATA(head, struct uvAliveWrite, queue)->n_reqs = 0;
+		}
 		/* When the write has failed additionally cancel all future
 		 * append related activity. This will also rewind
 		 * uv->append_next_index. All append requests need to be
@@ -312,12 +378,46 @@ out:
 		 * handle that + the accounting of the append index would be
 		 * off.
 		 */
-		uvAppendFinishPendingRequests(uv, status);
-		/* Allow this segment to be finalized further down. Don't bother
+		uvAppendFinishRequestsInQueue(uv, &uv->append_writing_reqs,
+					      s->status);
+		uvAppendFinishPendingRequests(uv, s->status);
+		/* Allow this segment to be finalized once idle. Don't bother
 		 * rewinding state to possibly reuse the segment for writing,
 		 * it's too bug-prone. */
 		s->pending_last_index = s->last_index;
 		s->finalize = true;
+	} else if (s->status == 0) {
+		s->written = w->written;
+		s->last_index = w->last_index;
+		/* Fire the callbacks of all requests that were fulfilled with
+		 * this write. */
+		uvAppendFinishWritingRequests(uv, w->n_reqs, 0);
+	}
+
+	if (s->spare.arena.base == NULL) {
+		uvSegmentBufferReset(&w->data, 0);
+		s->spare = w->data;
+	} else {
+		uvSegmentBufferClose(&w->data);
+	}
+	RaftHeapFree(w);
+}
+
+static void uvAliveWriteCb(struct UvWriterReq *req, const int status)
+{
+	struct uvAliveWrite *w = req->data;
+	struct uvAliveSegment *s = w->segment;
+	struct uv *uv = s->uv;
+	int rv;
+
+	dqlite_assert(uv->state != UV__CLOSED);
+
+	uvAliveWritePartDone(w, status);
+
+	/* Writes complete in the order they were submitted, so the callbacks
+	 * of the append requests fire in log order. */
+	while ((w = uvAliveSegmentFirstWrite(s)) != NULL && w->n_parts == 0) {
+		uvAliveWriteFinish(w);
 	}
 
 	/* During the closing sequence we should have already canceled all
@@ -325,7 +425,9 @@ out:
 	if (uv->closing) {
 		dqlite_assert(queue_empty(&uv->append_pending_reqs));
 		dqlite_assert(s->finalize);
-		uvAliveSegmentFinalize(s);
+		if (queue_empty(&s->writes) && !s->writer.closing) {
+			uvAliveSegmentFinalize(s);
+		}
 		return;
 	}
 
@@ -336,7 +438,7 @@ out:
 			uv->errored = true;
 		}
 	} else if (s->finalize && (s->pending_last_index == s->last_index) &&
-		   !s->writer.closing) {
+		   queue_empty(&s->writes) && !s->writer.closing) {
 		/* If there are no more append_pending_reqs or write requests in
 		 * flight, this segment must be finalized here in case we don't
 		 * receive AppendEntries RPCs anymore (could happen during a
@@ -348,25 +450,94 @@ out:
 }
 
 /* Submit a file write request to append the entries encoded in the write buffer
- * of the given segment. */
-static int uvAliveSegmentWrite(struct uvAliveSegment *s)
+ * of the given segment, fulfilling the last @n_reqs append requests in the
+ * writing queue. */
+static int uvAliveSegmentWrite(struct uvAliveSegment *s, unsigned n_reqs)
 {
+	struct uv *uv = s->uv;
+	struct uvAliveWrite *prev;
+	struct uvAliveWrite *w;
+	uv_buf_t buf;
+	unsigned n_blocks;
 	int rv;
+
 	dqlite_assert(s->counter != 0);
 	dqlite_assert(s->pending.n > 0);
-	uvSegmentBufferFinalize(&s->pending, &s->buf);
-	rv = UvWriterSubmit(&s->writer, &s->write, &s->buf, 1,
-			    s->next_block * s->uv->block_size,
-			    uvAliveSegmentWriteCb);
+
+	w = RaftHeapMalloc(sizeof *w);
+	if (w == NULL) {
+		return RAFT_NOMEM;
+	}
+	prev = uvAliveSegmentLastWrite(s);
+	uvSegmentBufferFinalize(&s->pending, &buf);
+	n_blocks = (unsigned)(buf.len / uv->block_size);
+
+	w->segment = s;
+	w->block = s->next_block;
+	w->head_req.data = w;
+	w->body_req.data = w;
+	w->head_deferred = false;
+	w->status = 0;
+	w->n_reqs = n_reqs;
+	w->last_index = s->pending_last_index;
+	w->written = s->next_block * uv->block_size + s->pending.n;
+
+	/* Hand the data over to the write, keeping a copy of its last block in
+	 * the pending buffer if it's only partially filled. */
+	w->data = s->spare;
+	uvSegmentBufferInit(&s->spare, uv->block_size);
+	rv = uvSegmentBufferTake(&s->pending, &w->data);
 	if (rv != 0) {
+		s->spare = w->data;
+		RaftHeapFree(w);
 		return rv;
 	}
+
+	if (s->pending.n != 0) {
+		s->next_block += n_blocks - 1;
+	} else {
+		s->next_block += n_blocks;
+	}
+
+	/* If the previous write ended in the middle of its last block, that
+	 * block is also the first one of this write: submit it only once the
+	 * previous write has made it to disk. */
+	if (prev != NULL && prev->n_parts > 0 &&
+	    prev->written % uv->block_size != 0) {
+		w->head.base = buf.base;
+		w->head.len = uv->block_size;
+		w->body.base = buf.base + uv->block_size;
+		w->body.len = buf.len - uv->block_size;
+		w->head_deferred = true;
+		w->n_parts = w->body.len > 0 ? 2 : 1;
+	} else {
+		w->body = buf;
+		w->n_parts = 1;
+	}
+
+	queue_insert_tail(&s->writes, &w->queue);
+	s->n_writes++;
+
+	if (w->body.len > 0) {
+		rv = UvWriterSubmit(&s->writer, &w->body_req, &w->body, 1,
+				    (w->block + (w->head_deferred ? 1 : 0)) *
+					uv->block_size,
+				    uvAliveWriteCb);
+		if (rv != 0) {
+			queue_remove(&w->queue);
+			s->n_writes--;
+			uvSegmentBufferClose(&w->data);
+			RaftHeapFree(w);
+			return rv;
+		}
+	}
+
 	return 0;
 }
 
 /* Start writing all pending append requests for the current segment, unless we
- * are already writing, or the segment itself has not yet been prepared or we
- * are blocked on a barrier. If there are no more requests targeted at the
+ * are already writing as much as allowed, or the segment itself has not yet been
+ * prepared or we are blocked on a barrier. If there are no more requests targeted at the
  * current segment, make sure it's marked to be finalize and try with the next
  * segment. */
 static int uvAppendMaybeStart(struct uv *uv)
@@ -381,11 +552,6 @@ static int uvAppendMaybeStart(struct uv *uv)
 	dqlite_assert(!uv->closing);
 	dqlite_assert(!queue_empty(&uv->append_pending_reqs));
 
-	/* If we are already writing, let's wait. */
-	if (!queue_empty(&uv->append_writing_reqs)) {
-		return 0;
-	}
-
 start:
 	segment = uvGetCurrentAliveSegment(uv);
 	dqlite_assert(segment != NULL);
@@ -394,6 +560,11 @@ start:
 		return 0;
 	}
 
+	/* If we are already writing as much as we can, let's wait. */
+	if (!uvAliveSegmentCanWrite(segment)) {
+		return 0;
+	}
+
 	/* If there's a blocking barrier in progress, and it's not waiting for
 	 * this segment to be finalized, let's wait.
 	 *
@@ -440,6 +611,11 @@ start:
 	 * request, in that case we need to wait for it). Otherwise it must mean
 	 * we have exhausted the queue of pending append requests. */
 	if (n_reqs == 0) {
+		/* The segment can't be finalized before all its writes are
+		 * done. */
+		if (!queue_empty(&segment->writes)) {
+			return 0;
+		}
 		dqlite_assert(queue_empty(&uv->append_writing_reqs));
 		if (segment->finalize) {
 			uvAliveSegmentFinalize(segment);
@@ -459,7 +635,7 @@ start:
 		queue_insert_tail(&uv->append_writing_reqs, head);
 	}
 
-	rv = uvAliveSegmentWrite(segment);
+	rv = uvAliveSegmentWrite(segment, n_reqs);
 	if (rv != 0) {
 		goto err;
 	}
@@ -481,7 +657,10 @@ static int uvAliveSegmentReady(struct uv *uv,
 {
 	int rv;
 	rv = UvWriterInit(&segment->writer, uv->loop, fd, uv->direct_io,
-			  uv->async_io, 1, uv->io->errmsg);
+			  uv->async_io, uv->uring && uv->uring_enabled,
+			  uv->append_max_writes > 1 ? 2 * uv->append_max_writes
+						    : 1,
+			  uv->io->errmsg);
 	if (rv != 0) {
 		ErrMsgWrapf(uv->io->errmsg, "setup writer for open-%llu",
 			    counter);
@@ -506,6 +685,7 @@ static void uvAliveSegmentPrepareCb(struct uvPrepare *req, int status)
 		dqlite_assert(status ==
 		       RAFT_CANCELED); /* UvPrepare cancels pending reqs */
 		uvSegmentBufferClose(&segment->pending);
+		uvSegmentBufferClose(&segment->spare);
 		RaftHeapFree(segment);
 		return;
 	}
@@ -550,7 +730,6 @@ static void uvAliveSegmentInit(struct uvAliveSegment *s, struct uv *uv)
 	s->uv = uv;
 	s->prepare.data = s;
 	s->writer.data = s;
-	s->write.data = s;
 	s->counter = 0;
 	s->first_index = uv->append_next_index;
 	s->pending_last_index = s->first_index - 1;
@@ -558,7 +737,11 @@ static void uvAliveSegmentInit(struct uvAliveSegment *s, struct uv *uv)
 	s->size = sizeof(uint64_t) /* Format version */;
 	s->next_block = 0;
 	uvSegmentBufferInit(&s->pending, uv->block_size);
+	uvSegmentBufferInit(&s->spare, uv->block_size);
 	s->written = 0;
+	queue_init(&s->writes);
+	s->n_writes = 0;
+	s->status = 0;
 	s->barrier = NULL;
 	s->finalize = false;
 }
@@ -802,7 +985,8 @@ static void uvFinalizeCurrentAliveSegmentOnceIdle(struct uv *uv)
 			break;
 		}
 	}
-	has_writing_reqs = !queue_empty(&uv->append_writing_reqs);
+	has_writing_reqs = !queue_empty(&uv->append_writing_reqs) ||
+			   !queue_empty(&s->writes);
 
 	/* If there is no pending append request or inflight write against the
 	 * current segment, we can submit a request for it to be closed
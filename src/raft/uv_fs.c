@@ -13,6 +13,7 @@
 #include "../lib/assert.h"
 #include "err.h"
 #include "heap.h"
+#include "syscall.h"
 #include "uv_fs.h"
 #include "uv_os.h"
 
@@ -1281,6 +1282,34 @@ static int probeAsyncIO(int fd, size_t size, bool *ok, char *errmsg)
 	return 0;
 }
 
+/* Check if io_uring can be used to write files. The kernel must not drop
+ * completions and must be done with the submitted data when io_uring_enter()
+ * returns. Failures just mean that io_uring won't be used. */
+#if HAVE_LINUX_IO_URING_H
+static void probeIoUring(bool *ok)
+{
+	struct io_uring_params p;
+	int fd;
+
+	*ok = false;
+	memset(&p, 0, sizeof p);
+	fd = UvOsIoUringSetup(1, &p);
+	if (fd < 0) {
+		return;
+	}
+	if ((p.features & IORING_FEAT_NODROP) &&
+	    (p.features & IORING_FEAT_SUBMIT_STABLE)) {
+		*ok = true;
+	}
+	UvOsClose(fd);
+}
+#else
+static void probeIoUring(bool *ok)
+{
+	*ok = false;
+}
+#endif
+
 #define UV__FS_PROBE_FALLOCATE_FILE ".probe_fallocate"
 /* Leave detection of other error conditions to other probe* functions, only
  * bother checking if posix_fallocate returns success. */
@@ -1311,6 +1340,7 @@ out:
 int UvFsProbeCapabilities(const char *dir,
 			  size_t *direct,
 			  bool *async,
+			  bool *uring,
 			  bool *fallocate,
 			  char *errmsg)
 {
@@ -1319,6 +1349,7 @@ int UvFsProbeCapabilities(const char *dir,
 	char ignored[RAFT_ERRMSG_BUF_SIZE];
 
 	probeFallocate(dir, fallocate);
+	probeIoUring(uring);
 
 	/* Create a temporary probe file. */
 	UvFsRemoveFile(dir, UV__FS_PROBE_FILE, ignored);
@@ -124,10 +124,14 @@ int UvFsRenameFile(const char *dir,
  * to the block size to use for direct I/O otherwise.
  *
  * The @async parameter will be set to true if fully asynchronous I/O is
- * possible using the KAIO API. */
+ * possible using the KAIO API.
+ *
+ * The @uring parameter will be set to true if writes can be performed using
+ * io_uring, which is then preferred to KAIO. */
 int UvFsProbeCapabilities(const char *dir,
 			  size_t *direct,
 			  bool *async,
+			  bool *uring,
 			  bool *fallocate,
 			  char *errmsg);
 
@@ -200,6 +200,68 @@ int UvOsIoGetevents(aio_context_t ctx,
 	return rv;
 }
 
+/* The io_uring wrappers fail with -ENOSYS if support for it was not available
+ * at build time. */
+int UvOsIoUringSetup(unsigned entries, struct io_uring_params *p)
+{
+#if HAVE_LINUX_IO_URING_H
+	int rv;
+	rv = io_uring_setup(entries, p);
+	if (rv == -1) {
+		return -errno;
+	}
+	return rv;
+#else
+	(void)entries;
+	(void)p;
+	return -ENOSYS;
+#endif
+}
+
+int UvOsIoUringEnter(int fd,
+		     unsigned to_submit,
+		     unsigned min_complete,
+		     unsigned flags)
+{
+#if HAVE_LINUX_IO_URING_H
+	int rv;
+	do {
+		rv = io_uring_enter(fd, to_submit, min_complete, flags, NULL);
+	} while (rv == -1 && errno == EINTR);
+	if (rv == -1) {
+		return -errno;
+	}
+	return rv;
+#else
+	(void)fd;
+	(void)to_submit;
+	(void)min_complete;
+	(void)flags;
+	return -ENOSYS;
+#endif
+}
+
+int UvOsIoUringRegister(int fd,
+			unsigned opcode,
+			const void *arg,
+			unsigned nr_args)
+{
+#if HAVE_LINUX_IO_URING_H
+	int rv;
+	rv = io_uring_register(fd, opcode, arg, nr_args);
+	if (rv == -1) {
+		return -errno;
+	}
+	return rv;
+#else
+	(void)fd;
+	(void)opcode;
+	(void)arg;
+	(void)nr_args;
+	return -ENOSYS;
+#endif
+}
+
 int UvOsEventfd(unsigned int initval, int flags)
 {
 	int rv;
@@ -82,6 +82,16 @@ int UvOsIoGetevents(aio_context_t ctx,
 		    long max_nr,
 		    struct io_event *events,
 		    struct timespec *timeout);
+struct io_uring_params;
+int UvOsIoUringSetup(unsigned entries, struct io_uring_params *p);
+int UvOsIoUringEnter(int fd,
+		     unsigned to_submit,
+		     unsigned min_complete,
+		     unsigned flags);
+int UvOsIoUringRegister(int fd,
+			unsigned opcode,
+			const void *arg,
+			unsigned nr_args);
 int UvOsEventfd(unsigned int initval, int flags);
 int UvOsSetDirectIo(uv_file fd);
 
@@ -822,6 +822,32 @@ void uvSegmentBufferReset(struct uvSegmentBuffer *b, unsigned retain)
 	b->n = b->n % b->block_size;
 }
 
+int uvSegmentBufferTake(struct uvSegmentBuffer *b, struct uvSegmentBuffer *out)
+{
+	struct uvSegmentBuffer data = *b;
+	size_t tail = b->n % b->block_size;
+	int rv;
+
+	dqlite_assert(b->n > 0);
+	dqlite_assert(out->block_size == b->block_size);
+
+	*b = *out;
+	b->n = 0;
+	if (tail != 0) {
+		rv = uvEnsureSegmentBufferIsLargeEnough(b, b->block_size);
+		if (rv != 0) {
+			*out = *b;
+			*b = data;
+			return rv;
+		}
+		memcpy(b->arena.base, data.arena.base + data.n - tail,
+		       b->block_size);
+		b->n = tail;
+	}
+	*out = data;
+	return 0;
+}
+
 /* When a corrupted segment is detected, the segment is renamed.
  * Upon a restart, raft will not detect the segment anymore and will try
  * to start without it.
@@ -1,11 +1,13 @@
 #include "uv_writer.h"
 
 #include <string.h>
+#include <sys/mman.h>
 #include <unistd.h>
 
 #include "../lib/assert.h"
 #include "../raft.h"
 #include "heap.h"
+#include "syscall.h"
 
 /* Copy the error message from the request object to the writer object. */
 static void uvWriterReqTransferErrMsg(struct UvWriterReq *req)
@@ -62,6 +64,193 @@ static int uvWriterIoSetup(unsigned n, aio_context_t *ctx, char *errmsg)
 	return 0;
 }
 
+#if HAVE_LINUX_IO_URING_H
+/* Release the memory mappings and the file descriptor of an io_uring
+ * instance. */
+static void uvWriterRingClose(struct UvWriterRing *r)
+{
+	if (r->sqes != NULL) {
+		munmap(r->sqes, r->sqes_size);
+	}
+	if (r->cq != NULL && r->cq != r->sq) {
+		munmap(r->cq, r->cq_size);
+	}
+	if (r->sq != NULL) {
+		munmap(r->sq, r->sq_size);
+	}
+	if (r->fd >= 0) {
+		UvOsClose(r->fd);
+	}
+	r->fd = -1;
+}
+
+/* Map a region of an io_uring instance in memory. */
+static void *uvWriterRingMap(int fd, size_t size, off_t offset)
+{
+	void *p;
+	p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		 fd, offset);
+	return p == MAP_FAILED ? NULL : p;
+}
+
+/* Create an io_uring instance able to hold @entries requests in flight, whose
+ * completions get signaled on @event_fd. */
+static int uvWriterRingSetup(struct UvWriterRing *r,
+			     unsigned entries,
+			     int event_fd,
+			     char *errmsg)
+{
+	struct io_uring_params p;
+	char *sq;
+	char *cq;
+	int rv;
+
+	memset(r, 0, sizeof *r);
+	memset(&p, 0, sizeof p);
+
+	rv = UvOsIoUringSetup(entries, &p);
+	if (rv < 0) {
+		UvOsErrMsg(errmsg, "io_uring_setup", rv);
+		r->fd = -1;
+		return RAFT_IOERR;
+	}
+	r->fd = rv;
+
+	r->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	r->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (r->cq_size > r->sq_size) {
+			r->sq_size = r->cq_size;
+		}
+		r->cq_size = r->sq_size;
+	}
+	r->sq = uvWriterRingMap(r->fd, r->sq_size, IORING_OFF_SQ_RING);
+	if (r->sq == NULL) {
+		goto err_mmap;
+	}
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		r->cq = r->sq;
+	} else {
+		r->cq = uvWriterRingMap(r->fd, r->cq_size, IORING_OFF_CQ_RING);
+		if (r->cq == NULL) {
+			goto err_mmap;
+		}
+	}
+	r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	r->sqes = uvWriterRingMap(r->fd, r->sqes_size, IORING_OFF_SQES);
+	if (r->sqes == NULL) {
+		goto err_mmap;
+	}
+
+	sq = r->sq;
+	cq = r->cq;
+	r->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+	r->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+	r->sq_array = (unsigned *)(sq + p.sq_off.array);
+	r->cq_head = (unsigned *)(cq + p.cq_off.head);
+	r->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+	r->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+	r->cqes = cq + p.cq_off.cqes;
+
+	rv = UvOsIoUringRegister(r->fd, IORING_REGISTER_EVENTFD, &event_fd, 1);
+	if (rv < 0) {
+		UvOsErrMsg(errmsg, "io_uring_register", rv);
+		uvWriterRingClose(r);
+		return RAFT_IOERR;
+	}
+
+	return 0;
+
+err_mmap:
+	UvOsErrMsg(errmsg, "mmap", -errno);
+	uvWriterRingClose(r);
+	return RAFT_IOERR;
+}
+
+/* Queue a vectored write in the submission ring and submit it. */
+static int uvWriterRingSubmit(struct UvWriterRing *r,
+			      struct UvWriterReq *req,
+			      int fd,
+			      const uv_buf_t bufs[],
+			      unsigned n,
+			      size_t offset)
+{
+	struct io_uring_sqe *sqe;
+	unsigned tail;
+	unsigned index;
+	int rv;
+
+	tail = *r->sq_tail;
+	index = tail & *r->sq_mask;
+	sqe = &((struct io_uring_sqe *)r->sqes)[index];
+	memset(sqe, 0, sizeof *sqe);
+	sqe->opcode = IORING_OP_WRITEV;
+	sqe->fd = fd;
+	sqe->addr = (uint64_t)(uintptr_t)bufs;
+	sqe->len = n;
+	sqe->off = (uint64_t)offset;
+	sqe->user_data = (uint64_t)(uintptr_t)req;
+	r->sq_array[index] = index;
+	__atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+	rv = UvOsIoUringEnter(r->fd, 1, 0, 0);
+	if (rv < 0) {
+		/* The kernel didn't consume the entry, take it back. */
+		__atomic_store_n(r->sq_tail, tail, __ATOMIC_RELEASE);
+		return rv;
+	}
+	dqlite_assert(rv == 1);
+	return 0;
+}
+
+/* Pop the next completion from the completion ring, if any, returning the
+ * associated request and setting @res to the result of the write. */
+static struct UvWriterReq *uvWriterRingReap(struct UvWriterRing *r, int *res)
+{
+	struct io_uring_cqe *cqe;
+	unsigned head;
+
+	head = *r->cq_head;
+	if (head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) {
+		return NULL;
+	}
+	cqe = &((struct io_uring_cqe *)r->cqes)[head & *r->cq_mask];
+	*res = cqe->res;
+	__atomic_store_n(r->cq_head, head + 1, __ATOMIC_RELEASE);
+	return (struct UvWriterReq *)(uintptr_t)cqe->user_data;
+}
+
+/* Block until all writes in flight have completed, discarding their results:
+ * the memory they write from might be released as soon as they get canceled. */
+static void uvWriterRingDrain(struct UvWriter *w)
+{
+	unsigned n = 0;
+	queue *head;
+	int res;
+	int rv;
+
+	QUEUE_FOREACH(head, &w->poll_queue)
+	{
+		n++;
+	}
+	while (n > 0) {
+		while (n > 0 && uvWriterRingReap(&w->ring, &res) != NULL) {
+			n--;
+		}
+		if (n == 0) {
+			break;
+		}
+		rv = UvOsIoUringEnter(w->ring.fd, 0, 1,
+				      IORING_ENTER_GETEVENTS);
+		dqlite_assert(rv >= 0);
+		if (rv < 0) {
+			/* UNTESTED: nothing sensible can be done here. */
+			break;
+		}
+	}
+}
+#endif
+
 /* Run blocking syscalls involved in a file write request.
  *
  * Perform a KAIO write request and synchronously wait for it to complete. */
@@ -172,6 +361,18 @@ static void uvWriterPollCb(uv_poll_t *poller, int status, int events)
 	/* TODO: this assertion fails in unit tests */
 	/* dqlite_assert(completed == 1); */
 
+#if HAVE_LINUX_IO_URING_H
+	if (w->uring) {
+		struct UvWriterReq *req;
+		int res;
+		while ((req = uvWriterRingReap(&w->ring, &res)) != NULL) {
+			uvWriterReqSetStatus(req, res);
+			uvWriterReqFinish(req);
+		}
+		return;
+	}
+#endif
+
 	/* Try to fetch the write responses.
 	 *
 	 * If we got here at least one write should have completed and io_events
@@ -234,6 +435,7 @@ int UvWriterInit(struct UvWriter *w,
 		 uv_file fd,
 		 bool direct /* Whether to use direct I/O */,
 		 bool async /* Whether async I/O is available */,
+		 bool uring /* Whether io_uring is available */,
 		 unsigned max_concurrent_writes,
 		 char *errmsg)
 {
@@ -244,6 +446,13 @@ int UvWriterInit(struct UvWriter *w,
 	w->loop = loop;
 	w->fd = fd;
 	w->async = async;
+#if HAVE_LINUX_IO_URING_H
+	w->uring = uring;
+#else
+	(void)uring;
+	w->uring = false;
+#endif
+	w->ring.fd = -1;
 	w->ctx = 0;
 	w->events = NULL;
 	w->n_events = max_concurrent_writes;
@@ -266,10 +475,12 @@ int UvWriterInit(struct UvWriter *w,
 		}
 	}
 
-	/* Setup the AIO context. */
-	rv = uvWriterIoSetup(w->n_events, &w->ctx, errmsg);
-	if (rv != 0) {
-		goto err;
+	/* Setup the AIO context, unless io_uring is used instead. */
+	if (!w->uring) {
+		rv = uvWriterIoSetup(w->n_events, &w->ctx, errmsg);
+		if (rv != 0) {
+			goto err;
+		}
 	}
 
 	/* Initialize the array of reusable event objects. */
@@ -292,6 +503,16 @@ int UvWriterInit(struct UvWriter *w,
 	}
 	w->event_fd = rv;
 
+#if HAVE_LINUX_IO_URING_H
+	if (w->uring) {
+		rv = uvWriterRingSetup(&w->ring, w->n_events, w->event_fd,
+				       errmsg);
+		if (rv != 0) {
+			goto err_after_event_fd;
+		}
+	}
+#endif
+
 	rv = uv_poll_init(loop, &w->event_poller, w->event_fd);
 	if (rv != 0) {
 		/* UNTESTED: with the current libuv implementation this should
@@ -324,11 +545,16 @@ int UvWriterInit(struct UvWriter *w,
 	return 0;
 
 err_after_event_fd:
+#if HAVE_LINUX_IO_URING_H
+	uvWriterRingClose(&w->ring);
+#endif
 	UvOsClose(w->event_fd);
 err_after_events_alloc:
 	RaftHeapFree(w->events);
 err_after_io_setup:
-	UvOsIoDestroy(w->ctx);
+	if (!w->uring) {
+		UvOsIoDestroy(w->ctx);
+	}
 err:
 	dqlite_assert(rv != 0);
 	return rv;
@@ -340,7 +566,12 @@ static void uvWriterCleanUpAndFireCloseCb(struct UvWriter *w)
 
 	UvOsClose(w->fd);
 	RaftHeapFree(w->events);
-	UvOsIoDestroy(w->ctx);
+#if HAVE_LINUX_IO_URING_H
+	uvWriterRingClose(&w->ring);
+#endif
+	if (!w->uring) {
+		UvOsIoDestroy(w->ctx);
+	}
 
 	if (w->close_cb != NULL) {
 		w->close_cb(w);
@@ -396,6 +627,14 @@ void UvWriterClose(struct UvWriter *w, UvWriterCloseCb cb)
 	w->closing = true;
 	w->close_cb = cb;
 
+#if HAVE_LINUX_IO_URING_H
+	/* Writes submitted through io_uring can't be waited for once the ring
+	 * is gone, so do it now, before they get canceled. */
+	if (w->uring) {
+		uvWriterRingDrain(w);
+	}
+#endif
+
 	/* We can close the event file descriptor right away, but we shouldn't
 	 * close the main file descriptor or destroy the AIO context since there
 	 * might be threadpool requests in flight. */
@@ -447,7 +686,7 @@ int UvWriterSubmit(struct UvWriter *w,
 
 	dqlite_assert(w->fd >= 0);
 	dqlite_assert(w->event_fd >= 0);
-	dqlite_assert(w->ctx != 0);
+	dqlite_assert(w->uring || w->ctx != 0);
 	dqlite_assert(req != NULL);
 	dqlite_assert(bufs != NULL);
 	dqlite_assert(n > 0);
@@ -460,6 +699,23 @@ int UvWriterSubmit(struct UvWriter *w,
 	memset(&req->iocb, 0, sizeof req->iocb);
 	memset(req->errmsg, 0, sizeof req->errmsg);
 
+#if HAVE_LINUX_IO_URING_H
+	/* With io_uring the kernel takes care of performing the write without
+	 * blocking, so no threadpool fallback is needed. The file is opened
+	 * with O_DSYNC, so the data is durable once the write completes. */
+	if (w->uring) {
+		queue_insert_tail(&w->poll_queue, &req->queue);
+		rv = uvWriterRingSubmit(&w->ring, req, w->fd, bufs, n, offset);
+		if (rv != 0) {
+			queue_remove(&req->queue);
+			UvOsErrMsg(w->errmsg, "io_uring_enter", rv);
+			rv = RAFT_IOERR;
+			goto err;
+		}
+		goto done;
+	}
+#endif
+
 	req->iocb.aio_fildes = (uint32_t)w->fd;
 	req->iocb.aio_lio_opcode = IOCB_CMD_PWRITEV;
 	req->iocb.aio_reqprio = 0;
@@ -16,12 +16,33 @@ struct UvWriter;
  * released. */
 typedef void (*UvWriterCloseCb)(struct UvWriter *w);
 
+/* Submission and completion rings of an io_uring instance, mapped in memory. */
+struct UvWriterRing
+{
+	int fd;             /* io_uring file descriptor, or -1 */
+	void *sq;           /* Submission ring */
+	size_t sq_size;     /* Size of the submission ring mapping */
+	void *cq;           /* Completion ring, possibly the same as @sq */
+	size_t cq_size;     /* Size of the completion ring mapping */
+	void *sqes;         /* Array of submission entries */
+	size_t sqes_size;   /* Size of the submission entries mapping */
+	unsigned *sq_tail;  /* Tail of the submission ring */
+	unsigned *sq_mask;  /* Mask of the submission ring */
+	unsigned *sq_array; /* Indexes of submitted entries */
+	unsigned *cq_head;  /* Head of the completion ring */
+	unsigned *cq_tail;  /* Tail of the completion ring */
+	unsigned *cq_mask;  /* Mask of the completion ring */
+	void *cqes;         /* Array of completion entries */
+};
+
 struct UvWriter
 {
 	void *data;              /* User data */
 	struct uv_loop_s *loop;  /* Event loop */
 	uv_file fd;              /* File handle */
 	bool async;              /* Whether fully async I/O is supported */
+	bool uring;              /* Whether writes go through io_uring */
+	struct UvWriterRing ring; /* io_uring instance, if used */
 	aio_context_t ctx;       /* KAIO handle */
 	struct io_event *events; /* Array of KAIO response objects */
 	unsigned n_events;       /* Length of the events array */
@@ -36,12 +57,16 @@ struct UvWriter
 	char *errmsg;             /* Description of last error */
 };
 
-/* Initialize a file writer. */
+/* Initialize a file writer.
+ *
+ * If @uring is true, writes are submitted through an io_uring instance instead
+ * of KAIO, and never need to fall back to the threadpool. */
 int UvWriterInit(struct UvWriter *w,
 		 struct uv_loop_s *loop,
 		 uv_file fd,
 		 bool direct /* Whether to use direct I/O */,
 		 bool async /* Whether async I/O is available */,
+		 bool uring /* Whether io_uring is available */,
 		 unsigned max_concurrent_writes,
 		 char *errmsg);
 
@@ -4,23 +4,81 @@
 
 #include "lib/assert.h"
 #include "registry.h"
+#include "utils.h"
 #include "vfs.h"
 
-static void registryDeleteHook(void *data, const char *filename)
+/* Initial number of hash buckets, the table doubles whenever the number of
+ * databases reaches the number of buckets. */
+#define REGISTRY_MIN_BUCKETS 16
+
+static struct db **registryBucket(const struct registry *r, uint32_t hash)
 {
-	struct registry *r = data;
+	PRE(is_po2(r->n_buckets));
+	return &r->buckets[hash & (r->n_buckets - 1)];
+}
+
+/* Resize the hash table to n buckets, rehashing all databases. */
+static int registryRehash(struct registry *r, size_t n)
+{
+	struct db **buckets;
 	queue *head;
+
+	PRE(is_po2(n));
+	buckets = sqlite3_malloc64(n * sizeof *buckets);
+	if (buckets == NULL) {
+		return DQLITE_NOMEM;
+	}
+	memset(buckets, 0, n * sizeof *buckets);
+	sqlite3_free(r->buckets);
+	r->buckets = buckets;
+	r->n_buckets = n;
 	QUEUE_FOREACH(head, &r->dbs)
 	{
 		struct db *db = QUEUE_DATA(head, struct db, queue);
-		if (strcmp(db->filename, filename) == 0) {
-			queue_remove(head);
-			db__close(db);
-			sqlite3_free(db);
-			r->size--;
-			return;
+		struct db **bucket = registryBucket(r, db->cookie);
+		db->next = *bucket;
+		*bucket = db;
+	}
+	return DQLITE_OK;
+}
+
+/* Return a pointer to the link pointing at the db with the given filename, or
+ * to the NULL link terminating its bucket if there is no such db. */
+static struct db **registryLookup(const struct registry *r,
+				  const char *filename)
+{
+	struct db **link;
+	uint32_t hash = db__hash(filename);
+
+	for (link = registryBucket(r, hash); *link != NULL;
+	     link = &(*link)->next) {
+		if ((*link)->cookie == hash &&
+		    strcmp((*link)->filename, filename) == 0) {
+			break;
 		}
 	}
+	return link;
+}
+
+static void registryDeleteHook(void *data, const char *filename)
+{
+	struct registry *r = data;
+	struct db **link;
+	struct db *db;
+
+	if (r->n_buckets == 0) {
+		return;
+	}
+	link = registryLookup(r, filename);
+	db = *link;
+	if (db == NULL) {
+		return;
+	}
+	*link = db->next;
+	queue_remove(&db->queue);
+	db__close(db);
+	sqlite3_free(db);
+	r->size--;
 }
 
 void registry__init(struct registry *r, struct config *config)
@@ -36,6 +94,11 @@ void registry__init(struct registry *r, struct config *config)
 
 void registry__close(struct registry *r)
 {
+	/* Closing idle connections must not call back into the registry. */
+	sqlite3_vfs *vfs = sqlite3_vfs_find(r->config->vfs.name);
+	dqlite_assert(vfs != NULL);
+	VfsDeleteHook(vfs, NULL, NULL);
+
 	while (!queue_empty(&r->dbs)) {
 		struct db *db;
 		queue *head;
@@ -46,23 +109,43 @@ void registry__close(struct registry *r)
 		sqlite3_free(db);
 	}
 	r->size = 0;
-	sqlite3_vfs *vfs = sqlite3_vfs_find(r->config->vfs.name);
-	dqlite_assert(vfs != NULL);
-	VfsDeleteHook(vfs, NULL, NULL);
+	sqlite3_free(r->buckets);
+	r->buckets = NULL;
+	r->n_buckets = 0;
 }
 
 int registry__get_or_create(struct registry *r, const char *filename, struct db **db)
 {
+	struct db **link;
+	int rv;
+
 	*db = registry__get(r, filename);
 	if (*db != NULL) {
 		return DQLITE_OK;
 	}
 
+	if (r->size >= r->n_buckets) {
+		rv = registryRehash(r, r->n_buckets == 0 ? REGISTRY_MIN_BUCKETS
+							 : r->n_buckets * 2);
+		/* A full table is still usable, only longer chains. */
+		if (rv != DQLITE_OK && r->n_buckets == 0) {
+			return rv;
+		}
+	}
+
 	*db = sqlite3_malloc(sizeof(struct db));
 	if (*db == NULL) {
 		return DQLITE_NOMEM;
 	}
-	db__init(*db, r->config, filename);
+	rv = db__init(*db, r->config, filename);
+	if (rv != DQLITE_OK) {
+		sqlite3_free(*db);
+		*db = NULL;
+		return rv;
+	}
+	link = registryBucket(r, (*db)->cookie);
+	(*db)->next = *link;
+	*link = *db;
 	queue_insert_tail(&r->dbs, &(*db)->queue);
 	r->size++;
 	return DQLITE_OK;
@@ -70,13 +153,8 @@ int registry__get_or_create(struct registry *r, const char *filename, struct db
 
 struct db *registry__get(const struct registry *r, const char *filename)
 {
-	queue *head;
-	QUEUE_FOREACH(head, &r->dbs)
-	{
-		struct db *db = QUEUE_DATA(head, struct db, queue);
-		if (strcmp(db->filename, filename) == 0) {
-			return db;
-		}
+	if (r->n_buckets == 0) {
+		return NULL;
 	}
-	return NULL;
+	return *registryLookup(r, filename);
 }
@@ -12,8 +12,10 @@
 struct registry
 {
 	struct config *config;
-	queue dbs;
-	size_t size;
+	queue dbs;          /* All databases, in creation order */
+	size_t size;        /* Number of databases */
+	struct db **buckets; /* Databases hashed by cookie */
+	size_t n_buckets;   /* Always zero or a power of two */
 };
 
 void registry__init(struct registry *r, struct config *config);
@@ -432,6 +432,15 @@ int dqlite_node_set_block_size(dqlite_node *n, size_t size)
 	return 0;
 }
 
+int dqlite_node_set_max_concurrent_writes(dqlite_node *n, unsigned n_writes)
+{
+	if (n_writes == 0) {
+		return DQLITE_MISUSE;
+	}
+	raft_uv_set_max_concurrent_writes(&n->raft_io, n_writes);
+	return 0;
+}
+
 static int maybeBootstrap(dqlite_node *d,
 			  dqlite_node_id id,
 			  const char *address)
@@ -480,10 +489,25 @@ static void raftCloseCb(struct raft *raft)
 	uv_close((struct uv_handle_s *)&s->timer, NULL);
 }
 
+/* Close the thread pool once the node is stopping and the last client
+ * connection is gone: SQLite work is only queued by connections, so nothing
+ * can be in flight anymore. */
+static void maybeClosePool(struct dqlite_node *d)
+{
+	if (d->running || d->pool_closed || !queue_empty(&d->conns)) {
+		return;
+	}
+	pool_close(&d->pool);
+	d->pool_closed = true;
+}
+
 static void destroy_conn(struct conn *conn)
 {
+	struct dqlite_node *d = CONTAINER_OF(conn->config, struct dqlite_node,
+					     config);
 	queue_remove(&conn->queue);
 	sqlite3_free(conn);
+	maybeClosePool(d);
 }
 
 static void handoverDoneCb(struct dqlite_node *d, int status)
@@ -535,6 +559,7 @@ static void stopCb(uv_async_t *stop)
 		conn = QUEUE_DATA(head, struct conn, queue);
 		conn__stop(conn);
 	}
+	maybeClosePool(d);
 	raft_close(&d->raft, raftCloseCb);
 }
 
@@ -630,7 +655,7 @@ static void listenCb(uv_stream_t *listener, int status)
 		goto err;
 	}
 	rv = conn__start(conn, &t->config, &t->loop, &t->registry, &t->raft,
-			 stream, &t->raft_transport, destroy_conn);
+			 &t->pool, stream, &t->raft_transport, destroy_conn);
 	if (rv != 0) {
 		goto err_after_conn_alloc;
 	}
@@ -660,6 +685,17 @@ static int taskRun(struct dqlite_node *d)
 	 * times. */
 	dqlite_assert(d->listener != NULL);
 
+	rv = pool_init(&d->pool, &d->loop, d->config.pool_thread_count,
+		       POOL_QOS_PRIO_FAIR);
+	if (rv != 0) {
+		snprintf(d->errmsg, DQLITE_ERRMSG_BUF_SIZE, "pool_init(): %s",
+			 uv_strerror(rv));
+		/* Unblock any client of taskReady */
+		sem_post(&d->ready);
+		return rv;
+	}
+	d->pool_closed = false;
+
 	rv = uv_listen(d->listener, 128, listenCb);
 	if (rv != 0) {
 		return rv;
@@ -705,6 +741,7 @@ static int taskRun(struct dqlite_node *d)
 
 	rv = uv_run(&d->loop, UV_RUN_DEFAULT);
 	dqlite_assert(rv == 0);
+	pool_fini(&d->pool);
 
 	/* Unblock any client of taskReady */
 	rv = sem_post(&d->ready);
@@ -742,6 +779,33 @@ int dqlite_node_set_snapshot_compression(dqlite_node *n, bool enabled)
 	return raft_uv_set_snapshot_compression(&n->raft_io, enabled);
 }
 
+int dqlite_node_set_frames_compression(dqlite_node *n, bool enabled)
+{
+#ifndef LZ4_AVAILABLE
+	if (enabled) {
+		return DQLITE_MISUSE;
+	}
+#endif
+	n->config.frames_compression = enabled;
+	return 0;
+}
+
+int dqlite_node_set_append_entries_limits(dqlite_node *n,
+					  unsigned max_entries,
+					  size_t max_size,
+					  unsigned window)
+{
+	raft_set_max_append_entries(&n->raft, max_entries, max_size);
+	raft_set_pipeline_window(&n->raft, window);
+	return 0;
+}
+
+int dqlite_node_set_transaction_chunk_size(dqlite_node *n, size_t size)
+{
+	n->config.tx_chunk_size = size;
+	return 0;
+}
+
 int dqlite_node_set_auto_recovery(dqlite_node *n, bool enabled)
 {
 	raft_uv_set_auto_recovery(&n->raft_io, enabled);
@@ -750,6 +814,9 @@ int dqlite_node_set_auto_recovery(dqlite_node *n, bool enabled)
 
 int dqlite_node_set_pool_thread_count(dqlite_node *n, unsigned thread_count)
 {
+	if (thread_count == 0 || thread_count > POOL_THREADS_MAX) {
+		return DQLITE_MISUSE;
+	}
 	n->config.pool_thread_count = thread_count;
 	return 0;
 }
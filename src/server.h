@@ -28,6 +28,7 @@ struct dqlite_node {
 	struct registry registry;                /* Databases */
 	struct uv_loop_s loop;                   /* UV loop */
 	struct pool_s pool;                      /* Thread pool */
+	bool pool_closed;                        /* pool_close was called */
 	struct raft_uv_transport raft_transport; /* Raft libuv transport */
 	struct raft_io raft_io;                  /* libuv I/O */
 	struct raft_fsm raft_fsm;                /* dqlite FSM */
@@ -1250,6 +1250,32 @@ struct vfsMainFile {
 
 static uint32_t vfsDatabaseNumPages(struct vfsDatabase *database, bool use_wal);
 
+/* Whether the last committed transaction deleted the database. */
+static bool vfsDatabaseDeleted(struct vfsDatabase *database)
+{
+	if (vfsDatabaseNumPages(database, true) != 1) {
+		/* A deleted database only has 1 page. */
+		return false;
+	}
+
+	/* A deleted database has the in-header size set to 0. */
+	uint8_t *header;
+	if (database->wal.n_frames == 0) {
+		dqlite_assert(database->n_pages > 0);
+		header = database->pages[0];
+	} else {
+		struct vfsFrame *frame =
+		    database->wal.frames[database->wal.n_frames - 1];
+		PRE(vfsFrameGetPageNumber(frame) == 1);
+		header = frame->page;
+	}
+
+	/* If the in-header database size is not 0, then the database is still
+	 * alive and it must not be removed */
+	uint32_t in_header_size = ByteGetBe32(&header[VFS__IN_HEADER_DATABASE_SIZE_OFFSET]);
+	return in_header_size == 0;
+}
+
 static int vfsMainFileClose(sqlite3_file *file)
 {
 	/* == Safety==
@@ -1271,27 +1297,7 @@ static int vfsMainFileClose(sqlite3_file *file)
 
 	/* This was the last open connection for this database. It is
 	 * possible now to run finalizers for this database. */
-	if (vfsDatabaseNumPages(f->database, true) != 1) {
-		/* A deleted database only has 1 page. */
-		return SQLITE_OK;
-	}
-
-	/* A deleted database has the in-header size set to 0. */
-	uint8_t *header;
-	if (f->database->wal.n_frames == 0) {
-		dqlite_assert(f->database->n_pages > 0);
-		header = f->database->pages[0];
-	} else {
-		struct vfsFrame *frame =
-		    f->database->wal.frames[f->database->wal.n_frames - 1];
-		PRE(vfsFrameGetPageNumber(frame) == 1);
-		header = frame->page;
-	}
-
-	/* If the in-header database size is not 0, then the database is still
-	 * alive and it must not be removed */
-	uint32_t in_header_size = ByteGetBe32(&header[VFS__IN_HEADER_DATABASE_SIZE_OFFSET]);
-	if (in_header_size != 0) {
+	if (!vfsDatabaseDeleted(f->database)) {
 		return SQLITE_OK;
 	}
 
@@ -2458,7 +2464,7 @@ static int vfsGetLastError(sqlite3_vfs *vfs, int x, char *y)
 	return rc;
 }
 
-static int vfsAuthorizer(void *pUserData, int action, const char *third, const char *fourth, const char *fifth, const char *sixth) {
+int VfsAuthorizer(void *pUserData, int action, const char *third, const char *fourth, const char *fifth, const char *sixth) {
 	(void)pUserData;
 	(void)fourth;
 	(void)fifth;
@@ -2575,7 +2581,7 @@ static int vfsOpenHook(sqlite3 *db,
 		return rv;
 	}
 
-	sqlite3_set_authorizer(db, vfsAuthorizer, NULL);
+	sqlite3_set_authorizer(db, VfsAuthorizer, NULL);
 
 	return SQLITE_OK;
 }
@@ -2978,9 +2984,16 @@ static int vfsCheckpoint(sqlite3 *conn, struct vfsMainFile *f)
 	int ckpt;
 	rv = sqlite3_wal_checkpoint_v2(conn, NULL, SQLITE_CHECKPOINT_TRUNCATE,
 				       &wal_size, &ckpt);
+	if (rv != SQLITE_OK) {
+		/* Only possible when running out of memory, the WAL is left
+		 * in place and the checkpoint can be retried later. */
+		tracef("[database %p] checkpoint failed %d", (void*)f->database, rv);
+		f->exclMask = 0;
+		vfsShmUnlock(&f->database->shm, 0, SQLITE_SHM_NLOCK, true);
+		return rv;
+	}
 	/* Since no reader transaction is in progress, we must be able to
 	 * checkpoint the entire WAL */
-	dqlite_assert(rv == SQLITE_OK);
 	dqlite_assert(wal_size == 0);
 	dqlite_assert(ckpt == 0);
 	tracef("[database %p] checkpointed", (void*)f->database);
@@ -3205,6 +3218,16 @@ uint64_t VfsDatabaseSize(sqlite3 *conn, unsigned n)
 	return (uint64_t)vfsDatabaseFileSize(f->database) + new_wal_size;
 }
 
+bool VfsDeleted(sqlite3 *conn)
+{
+	sqlite3_file *file;
+	int rv = sqlite3_file_control(conn, NULL, SQLITE_FCNTL_FILE_POINTER, &file);
+	dqlite_assert(rv == SQLITE_OK);
+	struct vfsMainFile *f = (struct vfsMainFile*)file;
+
+	return vfsDatabaseDeleted(f->database);
+}
+
 uint64_t VfsDatabaseSizeLimit(sqlite3 *conn)
 {
 	(void)conn;
@@ -2,6 +2,7 @@
 #define VFS_H_
 
 #include <sqlite3.h>
+#include <stdbool.h>
 #include <stddef.h> /* for size_t */
 #include <stdint.h> /* for uint{32,64}_t */
 
@@ -76,6 +77,19 @@ int VfsRestore(sqlite3 *conn, const struct vfsSnapshot *snapshot);
  * frames with the specified page_size. */
 uint64_t VfsDatabaseSize(sqlite3 *conn, unsigned n);
 
+/* Authorizer installed on every connection, denying statements that would
+ * break replication. */
+int VfsAuthorizer(void *data,
+		  int action,
+		  const char *arg1,
+		  const char *arg2,
+		  const char *db_name,
+		  const char *trigger);
+
+/* Whether the database has been deleted with PRAGMA delete_database. The
+ * database is removed once its last connection is closed. */
+bool VfsDeleted(sqlite3 *conn);
+
 /* Returns the the maximum size of the main file and wal file. */
 uint64_t VfsDatabaseSizeLimit(sqlite3 *conn);
 
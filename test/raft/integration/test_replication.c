@@ -362,6 +362,84 @@ TEST(replication, sendPipeline, setUp, tearDown, 0, NULL)
     return MUNIT_OK;
 }
 
+/* Submit N new entries to the I'th server with a single apply request. */
+#define APPLY_ADD_X_N(I, REQ, N)                                  \
+    {                                                             \
+        struct raft_buffer bufs_[N];                              \
+        unsigned i_;                                              \
+        int rv_;                                                  \
+        for (i_ = 0; i_ < N; i_++) {                              \
+            FsmEncodeAddX(1, &bufs_[i_]);                         \
+        }                                                         \
+        rv_ = raft_apply(CLUSTER_RAFT(I), REQ, bufs_, N, NULL);   \
+        munit_assert_int(rv_, ==, 0);                             \
+    }
+
+/* In pipeline mode, AppendEntries messages carry at most the configured number
+ * of entries. */
+TEST(replication, sendPipelineMaxEntries, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft *raft;
+    struct raft_apply req;
+    CLUSTER_BOOTSTRAP;
+    CLUSTER_START;
+
+    raft = CLUSTER_RAFT(0);
+    raft_set_max_append_entries(raft, 2, 0);
+
+    /* Server 0 becomes leader and the follower transitions to pipeline
+     * mode. */
+    CLUSTER_STEP_UNTIL_ELAPSED(1070);
+    ASSERT_LEADER(0);
+    munit_assert_int(CLUSTER_N_SEND(0, RAFT_IO_APPEND_ENTRIES), ==, 1);
+
+    /* Only the first two of the three new entries are sent. */
+    CLUSTER_STEP_UNTIL_ELAPSED(15);
+    APPLY_ADD_X_N(0, &req, 3);
+    CLUSTER_STEP;
+    munit_assert_int(CLUSTER_N_SEND(0, RAFT_IO_APPEND_ENTRIES), ==, 2);
+    munit_assert_int(raft->leader_state.progress[1].next_index, ==, 5);
+
+    /* The rest follows once the first message is acknowledged. */
+    CLUSTER_STEP_UNTIL_APPLIED(0, 5, 1000);
+    munit_assert_int(CLUSTER_N_SEND(0, RAFT_IO_APPEND_ENTRIES), ==, 3);
+
+    return MUNIT_OK;
+}
+
+/* In pipeline mode, the leader fills the window with messages for a lagging
+ * follower and stops sending entries when it's full. */
+TEST(replication, sendPipelineWindow, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft *raft;
+    struct raft_apply req;
+    CLUSTER_BOOTSTRAP;
+    CLUSTER_START;
+
+    raft = CLUSTER_RAFT(0);
+    raft_set_max_append_entries(raft, 1, 0);
+    raft_set_pipeline_window(raft, 2);
+
+    CLUSTER_STEP_UNTIL_ELAPSED(1070);
+    ASSERT_LEADER(0);
+    munit_assert_int(CLUSTER_N_SEND(0, RAFT_IO_APPEND_ENTRIES), ==, 1);
+
+    /* Two messages with one entry each are sent right away. */
+    CLUSTER_STEP_UNTIL_ELAPSED(15);
+    APPLY_ADD_X_N(0, &req, 4);
+    CLUSTER_STEP;
+    munit_assert_int(raft->leader_state.progress[1].next_index, ==, 5);
+    munit_assert_true(progressWindowIsFull(raft, 1));
+
+    /* The remaining entries are sent as the first ones are acknowledged. */
+    CLUSTER_STEP_UNTIL_APPLIED(0, 6, 1000);
+    munit_assert_false(progressWindowIsFull(raft, 1));
+
+    return MUNIT_OK;
+}
+
 /* A follower disconnects while in probe mode. */
 TEST(replication, sendDisconnect, setUp, tearDown, 0, NULL)
 {
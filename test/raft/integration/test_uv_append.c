@@ -325,6 +325,71 @@ TEST(append, wait, setUp, tearDown, 0, NULL)
     return MUNIT_OK;
 }
 
+static void appendCbAssertOrder(struct raft_io_append *req, int status)
+{
+    struct result *result = req->data;
+    struct result *prev = result->data;
+    munit_assert_int(status, ==, result->status);
+    munit_assert_true(prev == NULL || prev->done);
+    result->done = true;
+}
+
+/* With concurrent writes enabled, append requests submitted while a write is in
+ * progress are written right away, sharing the partially filled block of the
+ * previous write. */
+TEST(append, concurrentWrites, setUp, tearDownDeps, 0, NULL)
+{
+    struct fixture *f = data;
+    raft_uv_set_max_concurrent_writes(&f->io, 4);
+    APPEND(1, 64);
+    APPEND_SUBMIT(1, 1, 64);
+    APPEND_SUBMIT(2, 1, 5000);
+    APPEND_SUBMIT(3, 1, 64);
+    APPEND_SUBMIT(4, 2, 64);
+    APPEND_WAIT(1);
+    APPEND_WAIT(2);
+    APPEND_WAIT(3);
+    APPEND_WAIT(4);
+    ASSERT_ENTRIES(6, 64 + 64 + 5000 + 64 + 2 * 64);
+    return MUNIT_OK;
+}
+
+/* Callbacks of concurrent writes fire in the order the requests were
+ * submitted. */
+TEST(append, concurrentWritesOrder, setUp, tearDownDeps, 0, NULL)
+{
+    struct fixture *f = data;
+    raft_uv_set_max_concurrent_writes(&f->io, 4);
+    APPEND(1, 64);
+    APPEND_SUBMIT_CB_DATA(1, 1, 4096, appendCbAssertOrder, NULL, 0);
+    APPEND_SUBMIT_CB_DATA(2, 1, 64, appendCbAssertOrder, &_result1, 0);
+    APPEND_SUBMIT_CB_DATA(3, 1, 8192, appendCbAssertOrder, &_result2, 0);
+    APPEND_SUBMIT_CB_DATA(4, 1, 64, appendCbAssertOrder, &_result3, 0);
+    APPEND_WAIT(4);
+    munit_assert_true(_result1.done);
+    ASSERT_ENTRIES(5, 64 + 4096 + 64 + 8192 + 64);
+    return MUNIT_OK;
+}
+
+/* Concurrent writes that fill several segments. */
+TEST(append, concurrentWritesSeveralSegments, setUp, tearDownDeps, 0, NULL)
+{
+    struct fixture *f = data;
+    raft_uv_set_max_concurrent_writes(&f->io, 2);
+    APPEND_SUBMIT(0, 1, 6000);
+    APPEND_SUBMIT(1, 1, 6000);
+    APPEND_SUBMIT(2, 1, 6000);
+    APPEND_SUBMIT(3, 1, 6000);
+    APPEND_SUBMIT(4, 1, 6000);
+    APPEND_WAIT(0);
+    APPEND_WAIT(1);
+    APPEND_WAIT(2);
+    APPEND_WAIT(3);
+    APPEND_WAIT(4);
+    ASSERT_ENTRIES(5, 5 * 6000);
+    return MUNIT_OK;
+}
+
 /* Several batches with different size gets appended in fast pace, forcing the
  * segment arena to grow. */
 TEST(append, resizeArena, setUp, tearDownDeps, 0, NULL)
@@ -596,6 +661,8 @@ TEST(append, ioSetupError, setUp, tearDown, 0, NULL)
     struct fixture *f = data;
     aio_context_t ctx = 0;
     int rv;
+    /* Only KAIO needs AIO events. */
+    raft_uv_set_io_uring(&f->io, false);
     rv = AioFill(&ctx, 0);
     if (rv != 0) {
         return MUNIT_SKIP;
@@ -780,6 +780,50 @@ TEST(logAcquire, batch, setUp, tearDown, 0, NULL)
     return MUNIT_OK;
 }
 
+/* Acquire at most a given number of entries. */
+TEST(logAcquire, maxEntries, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft_entry *entries;
+    unsigned n;
+    int rv;
+
+    APPEND_MANY(1 /* term */, 5 /* n */);
+
+    rv = logAcquireAtMost(f->log, 2, 3, 0, &entries, &n);
+    munit_assert_int(rv, ==, 0);
+    munit_assert_int(n, ==, 3);
+    ASSERT_REFCOUNT(4 /* index */, 2 /* count */);
+    ASSERT_REFCOUNT(5 /* index */, 1 /* count */);
+    RELEASE(2 /* index */);
+
+    return MUNIT_OK;
+}
+
+/* Stop acquiring entries once their total size reaches the limit, but always
+ * acquire at least one. */
+TEST(logAcquire, maxSize, setUp, tearDown, 0, NULL)
+{
+    struct fixture *f = data;
+    struct raft_entry *entries;
+    unsigned n;
+    int rv;
+
+    APPEND_MANY(1 /* term */, 5 /* n */);
+
+    rv = logAcquireAtMost(f->log, 1, 0, 20, &entries, &n);
+    munit_assert_int(rv, ==, 0);
+    munit_assert_int(n, ==, 3);
+    RELEASE(1 /* index */);
+
+    rv = logAcquireAtMost(f->log, 1, 0, 1, &entries, &n);
+    munit_assert_int(rv, ==, 0);
+    munit_assert_int(n, ==, 1);
+    RELEASE(1 /* index */);
+
+    return MUNIT_OK;
+}
+
 /* Trying to acquire entries out of range results in a NULL pointer. */
 TEST(logAcquire, outOfRange, setUp, tearDown, 0, NULL)
 {
@@ -282,11 +282,12 @@ TEST(UvFsAllocateFile, noSpace, DirSetUp, DirTearDown, 0, noSpaceParams)
     {                                                                          \
         size_t direct_io_;                                                     \
         bool async_io_;                                                        \
+        bool uring_;                                                           \
         bool fallocate_;                                                       \
         char errmsg_[RAFT_ERRMSG_BUF_SIZE];                                    \
         int rv_;                                                               \
-        rv_ = UvFsProbeCapabilities(DIR, &direct_io_, &async_io_, &fallocate_, \
-                                    errmsg_);                                  \
+        rv_ = UvFsProbeCapabilities(DIR, &direct_io_, &async_io_, &uring_,     \
+                                    &fallocate_, errmsg_);                     \
         munit_assert_int(rv_, ==, 0);                                          \
         munit_assert_size(direct_io_, ==, DIRECT_IO);                          \
         munit_assert_int(fallocate_, ==, FALLOCATE);                           \
@@ -302,11 +303,12 @@ TEST(UvFsAllocateFile, noSpace, DirSetUp, DirTearDown, 0, noSpaceParams)
     {                                                                          \
         size_t direct_io_;                                                     \
         bool async_io_;                                                        \
+        bool uring_;                                                           \
         bool fallocate_;                                                       \
         char errmsg_[RAFT_ERRMSG_BUF_SIZE];                                    \
         int rv_;                                                               \
-        rv_ = UvFsProbeCapabilities(DIR, &direct_io_, &async_io_, &fallocate_, \
-                                    errmsg_);                                  \
+        rv_ = UvFsProbeCapabilities(DIR, &direct_io_, &async_io_, &uring_,     \
+                                    &fallocate_, errmsg_);                     \
         munit_assert_int(rv_, ==, RV);                                         \
         munit_assert_string_equal(errmsg_, ERRMSG);                            \
     }
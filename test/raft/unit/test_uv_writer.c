@@ -20,6 +20,7 @@ struct fixture
     size_t direct_io;
     bool fallocate;
     bool async_io;
+    bool uring;
     char errmsg[256];
     struct UvWriter writer;
     bool closed;
@@ -55,7 +56,18 @@ static void submitCbAssertResult(struct UvWriterReq *req, int status)
     do {                                                                   \
         int _rv;                                                           \
         _rv = UvWriterInit(&f->writer, &f->loop, f->fd, f->direct_io != 0, \
-                           f->async_io, MAX_WRITES, f->errmsg);            \
+                           f->async_io, false, MAX_WRITES, f->errmsg);     \
+        munit_assert_int(_rv, ==, 0);                                      \
+        f->writer.data = f;                                                \
+        f->closed = false;                                                 \
+    } while (0)
+
+/* Initialize the fixture's writer to use io_uring. */
+#define INIT_URING(MAX_WRITES)                                             \
+    do {                                                                   \
+        int _rv;                                                           \
+        _rv = UvWriterInit(&f->writer, &f->loop, f->fd, f->direct_io != 0, \
+                           f->async_io, true, MAX_WRITES, f->errmsg);      \
         munit_assert_int(_rv, ==, 0);                                      \
         f->writer.data = f;                                                \
         f->closed = false;                                                 \
@@ -67,7 +79,7 @@ static void submitCbAssertResult(struct UvWriterReq *req, int status)
     do {                                                                   \
         int _rv;                                                           \
         _rv = UvWriterInit(&f->writer, &f->loop, f->fd, f->direct_io != 0, \
-                           f->async_io, 1, f->errmsg);                     \
+                           f->async_io, false, 1, f->errmsg);              \
         munit_assert_int(_rv, ==, RV);                                     \
         munit_assert_string_equal(f->errmsg, ERRMSG);                      \
     } while (0)
@@ -193,7 +205,7 @@ static void *setUpDeps(const MunitParameter params[], void *user_data)
     SET_UP_DIR;
     SETUP_LOOP;
     rv = UvFsProbeCapabilities(f->dir, &f->direct_io, &f->async_io,
-                               &f->fallocate, errmsg);
+                               &f->uring, &f->fallocate, errmsg);
     munit_assert_int(rv, ==, 0);
     f->block_size = f->direct_io != 0 ? f->direct_io : 4096;
     rv = UvOsJoin(f->dir, "foo", path);
@@ -227,6 +239,20 @@ static void *setUp(const MunitParameter params[], void *user_data)
     return f;
 }
 
+static void *setUpUring(const MunitParameter params[], void *user_data)
+{
+    struct fixture *f = setUpDeps(params, user_data);
+    if (f == NULL) {
+        return NULL;
+    }
+    if (!f->uring) {
+        tearDownDeps(f);
+        return NULL;
+    }
+    INIT_URING(2);
+    return f;
+}
+
 static void tearDown(void *data)
 {
     struct fixture *f = data;
@@ -334,6 +360,46 @@ TEST(UvWriterSubmit, beyondEOF, setUp, tearDown, 0, DirAllParams)
     return MUNIT_OK;
 }
 
+/* Write a vector of buffers twice using io_uring. */
+TEST(UvWriterSubmit, uring, setUpUring, tearDown, 0, DirAllParams)
+{
+    struct fixture *f = data;
+    SKIP_IF_NO_FIXTURE;
+    WRITE(2 /* n bufs */, 1 /* content */, 0 /* offset */);
+    WRITE(2 /* n bufs */, 1 /* content */, 0 /* offset */);
+    ASSERT_CONTENT(2);
+    return MUNIT_OK;
+}
+
+/* Write two different blocks concurrently using io_uring. */
+TEST(UvWriterSubmit, uringConcurrent, setUpUring, tearDown, 0, DirAllParams)
+{
+    struct fixture *f = data;
+    struct uv_buf_t *bufs1;
+    struct uv_buf_t *bufs2;
+    struct UvWriterReq req1;
+    struct UvWriterReq req2;
+    struct result result1 = {0, false};
+    struct result result2 = {0, false};
+    int rv;
+    SKIP_IF_NO_FIXTURE;
+    MAKE_BUFS(bufs1, 1, 1);
+    MAKE_BUFS(bufs2, 1, 2);
+    req1.data = &result1;
+    req2.data = &result2;
+    rv = UvWriterSubmit(&f->writer, &req1, bufs1, 1, 0, submitCbAssertResult);
+    munit_assert_int(rv, ==, 0);
+    rv = UvWriterSubmit(&f->writer, &req2, bufs2, 1, f->block_size,
+                        submitCbAssertResult);
+    munit_assert_int(rv, ==, 0);
+    LOOP_RUN_UNTIL(&result1.done);
+    LOOP_RUN_UNTIL(&result2.done);
+    DESTROY_BUFS(bufs1, 1);
+    DESTROY_BUFS(bufs2, 1);
+    ASSERT_CONTENT(2);
+    return MUNIT_OK;
+}
+
 /* Write two different blocks concurrently. */
 TEST(UvWriterSubmit, concurrent, NULL, NULL, 0, DirAllParams)
 {
@@ -381,6 +447,15 @@ TEST(UvWriterClose, threadpool, setUp, tearDownDeps, 0, DirNoAioParams)
     return MUNIT_OK;
 }
 
+/* Close with an inflight io_uring write. */
+TEST(UvWriterClose, uring, setUpUring, tearDownDeps, 0, DirAllParams)
+{
+    struct fixture *f = data;
+    SKIP_IF_NO_FIXTURE;
+    WRITE_CLOSE(1, 0, 0, RAFT_CANCELED);
+    return MUNIT_OK;
+}
+
 /* Close with an inflight AIO write . */
 TEST(UvWriterClose, aio, setUp, tearDownDeps, 0, DirAioParams)
 {
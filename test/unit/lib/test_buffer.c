@@ -116,3 +116,28 @@ TEST_CASE(advance, double_twice, NULL)
 	ASSERT_N_PAGES(4);
 	return MUNIT_OK;
 }
+
+/******************************************************************************
+ *
+ * buffer__truncate
+ *
+ ******************************************************************************/
+
+TEST_SUITE(truncate);
+TEST_SETUP(truncate, setup);
+TEST_TEAR_DOWN(truncate, tear_down);
+
+/* Data written after the given offset is discarded. */
+TEST_CASE(truncate, discard, NULL)
+{
+	struct fixture *f = data;
+	void *cursor;
+	(void)params;
+	ADVANCE(16);
+	ADVANCE(8);
+	buffer__truncate(&f->buffer, 16);
+	munit_assert_int(buffer__offset(&f->buffer), ==, 16);
+	ADVANCE(8);
+	munit_assert_ptr_equal(cursor, buffer__cursor(&f->buffer, 16));
+	return MUNIT_OK;
+}
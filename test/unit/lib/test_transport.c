@@ -1,3 +1,4 @@
+#include <string.h>
 #include <unistd.h>
 
 #include "../../../src/lib/transport.h"
@@ -168,6 +169,24 @@ TEST_CASE(read, success, NULL)
 	return MUNIT_OK;
 }
 
+/* Data already available is read past the requested minimum. */
+TEST_CASE(read, at_least, NULL)
+{
+	struct fixture *f = data;
+	uv_buf_t buf = BUF_ALLOC(8);
+	int rv;
+	(void)params;
+	CLIENT_WRITE(5);
+	rv = transport__read_at_least(&f->transport, &buf, 2, read_cb);
+	munit_assert_int(rv, ==, 0);
+	test_uv_run(&f->loop, 1);
+	ASSERT_READ(0);
+	munit_assert_int(f->transport.read_n, ==, 5);
+	munit_assert_int(((uint8_t *)buf.base)[4], ==, 5);
+	free(buf.base);
+	return MUNIT_OK;
+}
+
 /******************************************************************************
  *
  * transport__write
@@ -189,3 +208,26 @@ TEST_CASE(write, success, NULL)
 	free(buf.base);
 	return MUNIT_OK;
 }
+
+TEST_CASE(write, vectored, NULL)
+{
+	struct fixture *f = data;
+	uv_buf_t bufs[2];
+	uint8_t received[5];
+	int rv;
+	(void)params;
+	bufs[0] = (uv_buf_t)BUF_ALLOC(2);
+	bufs[1] = (uv_buf_t)BUF_ALLOC(3);
+	memcpy(bufs[0].base, "\x01\x02", 2);
+	memcpy(bufs[1].base, "\x03\x04\x05", 3);
+	rv = transport__writev(&f->transport, bufs, 2, write_cb);
+	munit_assert_int(rv, ==, 0);
+	test_uv_run(&f->loop, 1);
+	ASSERT_WRITE(0);
+	rv = (int)read(f->client, received, sizeof received);
+	munit_assert_int(rv, ==, 5);
+	munit_assert_memory_equal(5, received, "\x01\x02\x03\x04\x05");
+	free(bufs[0].base);
+	free(bufs[1].base);
+	return MUNIT_OK;
+}
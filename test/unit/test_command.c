@@ -49,3 +49,101 @@ TEST_CASE(open, decode, NULL)
 	raft_free(buf.base);
 	return MUNIT_OK;
 }
+
+/******************************************************************************
+ *
+ * Frames.
+ *
+ ******************************************************************************/
+
+TEST_SUITE(frames);
+
+#define PAGE_SIZE 512
+
+/* Encode two pages with the given content and decode them back. */
+static void encodeDecodeFrames(char page1[PAGE_SIZE],
+			       char page2[PAGE_SIZE],
+			       bool compress,
+			       int expected_type)
+{
+	uint64_t page_numbers[2] = { 1, 7 };
+	void *pages[2] = { page1, page2 };
+	struct command_frames c1 = {
+		.filename = "test.db",
+		.is_commit = 1,
+		.frames = {
+			.n_pages = 2,
+			.page_size = PAGE_SIZE,
+			.page_numbers = page_numbers,
+			.pages = pages,
+		},
+	};
+	struct command_frames *c2;
+	struct raft_buffer buf;
+	void *c;
+	int type;
+	int rc;
+
+	rc = command__encode_frames(&c1, compress, &buf);
+	munit_assert_int(rc, ==, 0);
+	munit_assert_int(((uint8_t *)buf.base)[1], ==, expected_type);
+	rc = command__decode(&buf, &type, &c);
+	munit_assert_int(rc, ==, 0);
+	munit_assert_int(type, ==, COMMAND_FRAMES);
+	c2 = c;
+	munit_assert_string_equal(c2->filename, "test.db");
+	munit_assert_int(c2->is_commit, ==, 1);
+	munit_assert_uint32(c2->frames.n_pages, ==, 2);
+	munit_assert_uint16(c2->frames.page_size, ==, PAGE_SIZE);
+	munit_assert_uint64(c2->frames.page_numbers[0], ==, 1);
+	munit_assert_uint64(c2->frames.page_numbers[1], ==, 7);
+	munit_assert_memory_equal(PAGE_SIZE, c2->frames.pages[0], page1);
+	munit_assert_memory_equal(PAGE_SIZE, c2->frames.pages[1], page2);
+	sqlite3_free(c2->frames.page_numbers);
+	sqlite3_free(c2->frames.pages);
+	raft_free(c2);
+	raft_free(buf.base);
+}
+
+TEST_CASE(frames, decode, NULL)
+{
+	char page1[PAGE_SIZE];
+	char page2[PAGE_SIZE];
+	(void)data;
+	(void)params;
+	memset(page1, 'a', sizeof page1);
+	memset(page2, 'b', sizeof page2);
+	encodeDecodeFrames(page1, page2, false, COMMAND_FRAMES);
+	return MUNIT_OK;
+}
+
+#ifdef LZ4_AVAILABLE
+
+/* Compressible pages are encoded as a COMMAND_FRAMES_LZ4 command. */
+TEST_CASE(frames, compressed, NULL)
+{
+	char page1[PAGE_SIZE];
+	char page2[PAGE_SIZE];
+	(void)data;
+	(void)params;
+	memset(page1, 'a', sizeof page1);
+	memset(page2, 0, sizeof page2);
+	page2[100] = 'x';
+	encodeDecodeFrames(page1, page2, true, COMMAND_FRAMES_LZ4);
+	return MUNIT_OK;
+}
+
+/* Pages that don't compress are sent as they are. */
+TEST_CASE(frames, incompressible, NULL)
+{
+	char page1[PAGE_SIZE];
+	char page2[PAGE_SIZE];
+	(void)data;
+	(void)params;
+	munit_rand_memory(sizeof page1, (uint8_t *)page1);
+	munit_rand_memory(sizeof page2, (uint8_t *)page2);
+	encodeDecodeFrames(page1, page2, true, COMMAND_FRAMES);
+	return MUNIT_OK;
+}
+
+#endif /* LZ4_AVAILABLE */
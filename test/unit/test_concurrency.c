@@ -41,7 +41,8 @@ struct connection {
 		struct request_open open;                            \
 		struct response_db db;                               \
 		gateway__init(&(C)->gateway, CLUSTER_CONFIG(I),      \
-			      CLUSTER_REGISTRY(I), CLUSTER_RAFT(I)); \
+			      CLUSTER_REGISTRY(I), CLUSTER_RAFT(I),  \
+			      pool_ut_fallback());                   \
 		(C)->handle.data = &(C)->context;                    \
 		int connect_rv = buffer__init(&(C)->request);        \
 		munit_assert_int(connect_rv, ==, 0);                 \
@@ -482,6 +483,47 @@ TEST_CASE(exec, busy_wait_timeout, NULL)
 	return MUNIT_OK;
 }
 
+/* The statements following the first one of an EXEC_SQL request don't wait
+ * behind a write that is blocked by another leader's transaction. */
+TEST_CASE(exec, busy_wait_multi_statement, NULL)
+{
+	struct exec_fixture *f = data;
+	struct connection c3;
+	(void)params;
+
+	f->servers[0].config.busy_timeout = 1000;
+
+	PREPARE(f->c1, "CREATE TABLE test (n INT)", &f->stmt_id1);
+	EXEC(f->c1, f->stmt_id1);
+	WAIT(f->c1);
+	ASSERT_CALLBACK(f->c1, 0, RESULT);
+
+	PREPARE(f->c1, "BEGIN IMMEDIATE", &f->stmt_id1);
+	EXEC(f->c1, f->stmt_id1);
+	WAIT(f->c1);
+	ASSERT_CALLBACK(f->c1, 0, RESULT);
+
+	/* This write waits for the transaction of c1. */
+	PREPARE(f->c2, "INSERT INTO test(n) VALUES(1)", &f->stmt_id2);
+	EXEC(f->c2, f->stmt_id2);
+
+	CONNECT(&c3, 0);
+	EXEC_SQL(&c3, "SELECT * FROM test; SELECT n FROM test");
+	WAIT(&c3);
+	ASSERT_CALLBACK(&c3, 0, RESULT);
+	munit_assert_false(f->c2->context.invoked);
+
+	PREPARE(f->c1, "COMMIT", &f->stmt_id1);
+	EXEC(f->c1, f->stmt_id1);
+	WAIT(f->c1);
+	ASSERT_CALLBACK(f->c1, 0, RESULT);
+	WAIT(f->c2);
+	ASSERT_CALLBACK(f->c2, 0, RESULT);
+
+	HANGUP(&c3);
+	return MUNIT_OK;
+}
+
 static int faultyStartTimer(struct raft_io *io,
 			    struct raft_timer *req,
 			    uint64_t timeout,
@@ -618,6 +660,8 @@ TEST_SUITE(delete);
 TEST_SETUP(delete)
 {
 	struct delete_fixture *f = munit_malloc(sizeof *f);
+	pool_ut_fallback()->flags |= POOL_FOR_UT_NOT_ASYNC;
+	pool_ut_fallback()->flags |= POOL_FOR_UT;
 	SETUP_CLUSTER(V2);
 	CLUSTER_ELECT(0);
 	return f;
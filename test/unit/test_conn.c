@@ -1,3 +1,7 @@
+#ifdef LZ4_AVAILABLE
+#include <lz4.h>
+#endif
+
 #include "../lib/client.h"
 #include "../lib/config.h"
 #include "../lib/heap.h"
@@ -65,16 +69,17 @@ static void connCloseCb(struct conn *conn)
 	munit_assert_int(rv, ==, 0);                                         \
 	f->conn_test.closed = false;                                         \
 	rv = conn__start(&f->conn_test.conn, &f->config, &f->loop,           \
-			 &f->registry, &f->raft, stream, &f->raft_transport, \
-			 connCloseCb); \
+			 &f->registry, &f->raft, pool_ut_fallback(), stream, \
+			 &f->raft_transport, connCloseCb);                   \
 	munit_assert_int(rv, ==, 0)
 
 #define TEAR_DOWN                         \
-	pool_close(pool_ut_fallback());   \
 	conn__stop(&f->conn_test.conn);   \
 	while (!f->conn_test.closed) {    \
 		test_uv_run(&f->loop, 1); \
 	};                                \
+	pool_close(pool_ut_fallback());   \
+	test_uv_run(&f->loop, 1);         \
 	pool_fini(pool_ut_fallback());    \
 	TEAR_DOWN_RAFT;                   \
 	TEAR_DOWN_CLIENT;                 \
@@ -275,6 +280,28 @@ TEST_CASE(prepare, success, NULL)
 	return MUNIT_OK;
 }
 
+/* Requests sent back to back are received with a single read and handled in
+ * order. */
+TEST_CASE(prepare, pipelined, NULL)
+{
+	struct prepare_fixture *f = data;
+	unsigned stmt_id;
+	int rv;
+	(void)params;
+	rv = clientSendPrepare(&f->client, "CREATE TABLE test (n INT)", NULL);
+	munit_assert_int(rv, ==, 0);
+	rv = clientSendPrepare(&f->client, "SELECT 1", NULL);
+	munit_assert_int(rv, ==, 0);
+	test_uv_run(&f->loop, 3);
+	rv = clientRecvStmt(&f->client, &stmt_id, NULL, NULL, NULL);
+	munit_assert_int(rv, ==, 0);
+	munit_assert_int(stmt_id, ==, 0);
+	rv = clientRecvStmt(&f->client, &stmt_id, NULL, NULL, NULL);
+	munit_assert_int(rv, ==, 0);
+	munit_assert_int(stmt_id, ==, 1);
+	return MUNIT_OK;
+}
+
 /******************************************************************************
  *
  * Handle an exec
@@ -413,3 +440,101 @@ TEST_CASE(query, one, NULL)
 	munit_assert_int(row->values[0].integer, ==, 123);
 	return MUNIT_OK;
 }
+
+/******************************************************************************
+ *
+ * Compress responses
+ *
+ ******************************************************************************/
+
+#ifdef LZ4_AVAILABLE
+
+TEST_SUITE(compression);
+
+struct compression_fixture {
+	FIXTURE;
+};
+
+TEST_SETUP(compression)
+{
+	struct compression_fixture *f = munit_malloc(sizeof *f);
+	uint64_t protocol;
+	ssize_t n;
+	SETUP;
+	protocol = ByteFlipLe64(DQLITE_PROTOCOL_VERSION |
+				DQLITE_PROTOCOL_FEATURE_LZ4);
+	n = write(f->client.fd, &protocol, sizeof protocol);
+	munit_assert_int(n, ==, sizeof protocol);
+	test_uv_run(&f->loop, 1);
+	OPEN_CONN;
+	return f;
+}
+
+TEST_TEAR_DOWN(compression)
+{
+	struct compression_fixture *f = data;
+	TEAR_DOWN;
+	free(f);
+}
+
+/* A large ROWS response is compressed for clients that asked for it. */
+TEST_CASE(compression, rows, NULL)
+{
+	struct compression_fixture *f = data;
+	struct message message;
+	struct cursor cursor;
+	uint32_t stmt_id;
+	uint64_t uncompressed_size;
+	uint64_t compressed_size;
+	uint64_t column_count;
+	const char *column;
+	char header[8];
+	char *body;
+	char *rows;
+	ssize_t n;
+	int rv;
+	(void)params;
+
+	PREPARE_CONN("WITH RECURSIVE seq(n) AS (SELECT 1 UNION ALL "
+		     "SELECT n+1 FROM seq WHERE n < 100) "
+		     "SELECT 'dqlite dqlite dqlite' AS s FROM seq",
+		     &stmt_id);
+	rv = clientSendQuery(&f->client, stmt_id, NULL, 0, NULL);
+	munit_assert_int(rv, ==, 0);
+	test_uv_run(&f->loop, 2);
+
+	n = read(f->client.fd, header, sizeof header);
+	munit_assert_int(n, ==, sizeof header);
+	cursor.p = header;
+	cursor.cap = sizeof header;
+	rv = message__decode(&cursor, &message);
+	munit_assert_int(rv, ==, 0);
+	munit_assert_int(message.type, ==, DQLITE_RESPONSE_ROWS);
+	munit_assert_int(message.extra, ==, DQLITE_MESSAGE_LZ4);
+
+	body = munit_malloc(message.words * 8);
+	n = read(f->client.fd, body, message.words * 8);
+	munit_assert_int(n, ==, message.words * 8);
+	cursor.p = body;
+	cursor.cap = message.words * 8;
+	uint64__decode(&cursor, &uncompressed_size);
+	uint64__decode(&cursor, &compressed_size);
+	munit_assert_int(compressed_size, <, uncompressed_size);
+
+	rows = munit_malloc(uncompressed_size);
+	rv = LZ4_decompress_safe(cursor.p, rows, (int)compressed_size,
+				 (int)uncompressed_size);
+	munit_assert_int(rv, ==, uncompressed_size);
+	cursor.p = rows;
+	cursor.cap = uncompressed_size;
+	uint64__decode(&cursor, &column_count);
+	munit_assert_int(column_count, ==, 1);
+	text__decode(&cursor, &column);
+	munit_assert_string_equal(column, "s");
+
+	free(rows);
+	free(body);
+	return MUNIT_OK;
+}
+
+#endif /* LZ4_AVAILABLE */
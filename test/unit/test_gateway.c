@@ -64,7 +64,7 @@ struct connection {
 		config = CLUSTER_CONFIG(i);                                 \
 		config->vfs.page_size = 512;                                    \
 		gateway__init(&c->gateway, config, CLUSTER_REGISTRY(i),     \
-			      CLUSTER_RAFT(i));                                 \
+			      CLUSTER_RAFT(i), pool_ut_fallback());             \
 		c->handle.data = &c->context;                               \
 		rc = buffer__init(&c->buf1);                                \
 		munit_assert_int(rc, ==, 0);                                \
@@ -235,7 +235,7 @@ static void barrierCb(struct raft_barrier *req, int status) {
 /* Handle a request of the given type and check that no error occurs. */
 #define HANDLE(TYPE) HANDLE_STATUS(DQLITE_REQUEST_##TYPE, 0)
 
-#define CONNECT(i) gateway__init(f->gateway, CLUSTER_CONFIG(i), CLUSTER_REGISTRY(i), CLUSTER_RAFT(i))
+#define CONNECT(i) gateway__init(f->gateway, CLUSTER_CONFIG(i), CLUSTER_REGISTRY(i), CLUSTER_RAFT(i), pool_ut_fallback())
 
 /* Open a leader connection against the "test" database */
 #define OPEN                              \
@@ -2137,6 +2137,214 @@ TEST_CASE(query, manyParams, NULL)
 }
 
 
+/* Query rows in columnar format, with NULLs and variable size values. */
+TEST_CASE(query, columnar, NULL)
+{
+	struct query_fixture *f = data;
+	uint64_t stmt_id;
+	uint64_t n;
+	uint64_t word;
+	int64_t integer;
+	const char *column;
+	(void)params;
+	EXEC("INSERT INTO test(n, data) VALUES(1, x'0102')");
+	EXEC("INSERT INTO test(n, data) VALUES(NULL, NULL)");
+	EXEC("INSERT INTO test(n, data) VALUES(3, x'03')");
+
+	PREPARE("SELECT n, data, 'a' || n AS s FROM test ORDER BY rowid");
+	f->request.db_id = 0;
+	f->request.stmt_id = stmt_id;
+	ENCODE(&f->request, query);
+	HANDLE_SCHEMA_STATUS(DQLITE_REQUEST_QUERY,
+			     DQLITE_REQUEST_QUERY_SCHEMA_COLUMNAR, 0);
+	WAIT;
+	ASSERT_CALLBACK(0, ROWS);
+	munit_assert_int(f->context->schema, ==,
+			 DQLITE_RESPONSE_ROWS_SCHEMA_V1);
+
+	uint64__decode(f->cursor, &n);
+	munit_assert_int(n, ==, 3);
+	text__decode(f->cursor, &column);
+	munit_assert_string_equal(column, "n");
+	text__decode(f->cursor, &column);
+	munit_assert_string_equal(column, "data");
+	text__decode(f->cursor, &column);
+	munit_assert_string_equal(column, "s");
+
+	/* Number of rows */
+	uint64__decode(f->cursor, &n);
+	munit_assert_int(n, ==, 3);
+
+	/* Column "n" */
+	uint64__decode(f->cursor, &word);
+	munit_assert_int(word, ==, SQLITE_INTEGER);
+	uint64__decode(f->cursor, &word);
+	munit_assert_int(word, ==, 2);
+	int64__decode(f->cursor, &integer);
+	munit_assert_int(integer, ==, 1);
+	int64__decode(f->cursor, &integer);
+	munit_assert_int(integer, ==, 0);
+	int64__decode(f->cursor, &integer);
+	munit_assert_int(integer, ==, 3);
+
+	/* Column "data" */
+	uint64__decode(f->cursor, &word);
+	munit_assert_int(word, ==, SQLITE_BLOB);
+	uint64__decode(f->cursor, &word);
+	munit_assert_int(word, ==, 2);
+	uint64__decode(f->cursor, &word);
+	munit_assert_int(word, ==, 0);
+	uint64__decode(f->cursor, &word);
+	munit_assert_int(word, ==, 2);
+	uint64__decode(f->cursor, &word);
+	munit_assert_int(word, ==, 2);
+	uint64__decode(f->cursor, &word);
+	munit_assert_int(word, ==, 3);
+	munit_assert_memory_equal(3, f->cursor->p, "\x01\x02\x03");
+	f->cursor->p += 8;
+	f->cursor->cap -= 8;
+
+	/* Column "s" */
+	uint64__decode(f->cursor, &word);
+	munit_assert_int(word, ==, SQLITE_TEXT);
+	uint64__decode(f->cursor, &word);
+	munit_assert_int(word, ==, 2);
+	uint64__decode(f->cursor, &word);
+	munit_assert_int(word, ==, 0);
+	uint64__decode(f->cursor, &word);
+	munit_assert_int(word, ==, 2);
+	uint64__decode(f->cursor, &word);
+	munit_assert_int(word, ==, 2);
+	uint64__decode(f->cursor, &word);
+	munit_assert_int(word, ==, 4);
+	munit_assert_memory_equal(4, f->cursor->p, "a1a3");
+	f->cursor->p += 8;
+	f->cursor->cap -= 8;
+
+	DECODE(&f->response, rows);
+	munit_assert_ullong(f->response.eof, ==, DQLITE_RESPONSE_ROWS_DONE);
+
+	FINALIZE(stmt_id);
+	return MUNIT_OK;
+}
+
+/* A column changing type in the middle of a columnar query starts a new
+ * batch. */
+TEST_CASE(query, columnarTypeChange, NULL)
+{
+	struct query_fixture *f = data;
+	uint64_t stmt_id;
+	uint64_t n;
+	uint64_t word;
+	int64_t integer;
+	const char *column;
+	bool finished;
+	(void)params;
+	EXEC("INSERT INTO test(n) VALUES(1)");
+	EXEC("INSERT INTO test(n) VALUES('x')");
+
+	PREPARE("SELECT n FROM test ORDER BY rowid");
+	f->request.db_id = 0;
+	f->request.stmt_id = stmt_id;
+	ENCODE(&f->request, query);
+	HANDLE_SCHEMA_STATUS(DQLITE_REQUEST_QUERY,
+			     DQLITE_REQUEST_QUERY_SCHEMA_COLUMNAR, 0);
+	WAIT;
+	ASSERT_CALLBACK(0, ROWS);
+
+	uint64__decode(f->cursor, &n);
+	munit_assert_int(n, ==, 1);
+	text__decode(f->cursor, &column);
+	munit_assert_string_equal(column, "n");
+	uint64__decode(f->cursor, &n);
+	munit_assert_int(n, ==, 1);
+	uint64__decode(f->cursor, &word);
+	munit_assert_int(word, ==, SQLITE_INTEGER);
+	uint64__decode(f->cursor, &word);
+	munit_assert_int(word, ==, 0);
+	int64__decode(f->cursor, &integer);
+	munit_assert_int(integer, ==, 1);
+	DECODE(&f->response, rows);
+	munit_assert_ullong(f->response.eof, ==, DQLITE_RESPONSE_ROWS_PART);
+
+	gateway__resume(f->gateway, &finished);
+	munit_assert_false(finished);
+	WAIT;
+	ASSERT_CALLBACK(0, ROWS);
+
+	uint64__decode(f->cursor, &n);
+	munit_assert_int(n, ==, 1);
+	text__decode(f->cursor, &column);
+	munit_assert_string_equal(column, "n");
+	uint64__decode(f->cursor, &n);
+	munit_assert_int(n, ==, 1);
+	uint64__decode(f->cursor, &word);
+	munit_assert_int(word, ==, SQLITE_TEXT);
+	uint64__decode(f->cursor, &word);
+	munit_assert_int(word, ==, 0);
+	uint64__decode(f->cursor, &word);
+	munit_assert_int(word, ==, 0);
+	uint64__decode(f->cursor, &word);
+	munit_assert_int(word, ==, 1);
+	munit_assert_memory_equal(1, f->cursor->p, "x");
+	f->cursor->p += 8;
+	f->cursor->cap -= 8;
+	DECODE(&f->response, rows);
+	munit_assert_ullong(f->response.eof, ==, DQLITE_RESPONSE_ROWS_DONE);
+
+	gateway__resume(f->gateway, &finished);
+	munit_assert_true(finished);
+	FINALIZE(stmt_id);
+	return MUNIT_OK;
+}
+
+/* A query exceeding the inline budget is restarted on the thread pool without
+ * duplicating the rows it had already produced. */
+TEST_CASE(query, inlineBudgetExceeded, NULL)
+{
+	struct query_fixture *f = data;
+	unsigned i;
+	uint64_t stmt_id;
+	uint64_t n;
+	const char *column;
+	struct value value;
+	bool finished;
+	(void)params;
+
+	f->gateway->config->query_inline_budget = 1;
+	PREPARE("WITH RECURSIVE seq(n) AS ("
+		"	SELECT 1               "
+		"	UNION ALL              "
+		"	SELECT n+1             "
+		"	FROM seq WHERE n < 100 "
+		")                         "
+		"SELECT * FROM seq         ");
+	f->request.db_id = 0;
+	f->request.stmt_id = stmt_id;
+	ENCODE(&f->request, query);
+	HANDLE(QUERY);
+	WAIT;
+	ASSERT_CALLBACK(0, ROWS);
+
+	uint64__decode(f->cursor, &n);
+	munit_assert_int(n, ==, 1);
+	text__decode(f->cursor, &column);
+	munit_assert_string_equal(column, "n");
+	for (i = 1; i <= 100; i++) {
+		DECODE_ROW(1, &value);
+		munit_assert_int(value.type, ==, SQLITE_INTEGER);
+		munit_assert_int(value.integer, ==, i);
+	}
+	DECODE(&f->response, rows);
+	munit_assert_ullong(f->response.eof, ==, DQLITE_RESPONSE_ROWS_DONE);
+	munit_assert_int(f->cursor->cap, ==, 0);
+
+	gateway__resume(f->gateway, &finished);
+	munit_assert_true(finished);
+	FINALIZE(stmt_id);
+	return MUNIT_OK;
+}
+
 /* Successfully query that yields a large number of rows that need to be split
  * into several responses. */
 TEST_CASE(query, close_while_in_flight, NULL)
@@ -3182,6 +3390,37 @@ struct request_dump_fixture {
 	char *temp_dir;
 };
 
+/* Append the streamed tail of a DUMP response to the part found in the
+ * response buffer, pointing the cursor to the full body. */
+static char *dumpStream(struct request_dump_fixture *f, unsigned *chunks)
+{
+	size_t len = f->cursor->cap + f->handle->stream_len;
+	char *body = munit_malloc(len);
+	char *cur = body;
+	uv_buf_t *bufs;
+	unsigned n;
+
+	memcpy(cur, f->cursor->p, f->cursor->cap);
+	cur += f->cursor->cap;
+	*chunks = 0;
+	for (;;) {
+		gateway__stream(f->gateway, &bufs, &n);
+		if (n == 0) {
+			break;
+		}
+		for (unsigned i = 0; i < n; i++) {
+			memcpy(cur, bufs[i].base, bufs[i].len);
+			cur += bufs[i].len;
+		}
+		(*chunks)++;
+	}
+	munit_assert_ptr_equal(cur, body + len);
+
+	f->cursor->p = body;
+	f->cursor->cap = len;
+	return body;
+}
+
 TEST_SUITE(dump);
 TEST_SETUP(dump)
 {
@@ -3321,6 +3560,7 @@ TEST_CASE(dump, checkpointed, NULL)
 	(void)params;
 	struct request_dump_fixture *f = data;
 	uint64_t stmt_id;
+	unsigned chunks;
 
 	OPEN;
 	EXEC("CREATE TABLE test (data BLOB)");
@@ -3355,6 +3595,7 @@ TEST_CASE(dump, checkpointed, NULL)
 	ENCODE(&f->request, dump);
 	HANDLE(DUMP);
 	ASSERT_CALLBACK(DQLITE_OK, FILES);
+	char *body = dumpStream(f, &chunks);
 	DECODE(&f->response, files);
 
 	munit_assert_int(f->response.n, ==, 2);
@@ -3372,6 +3613,50 @@ TEST_CASE(dump, checkpointed, NULL)
 	munit_assert_int(f->cursor->cap, ==, 0);
 
 	INTEGRITY_CHECK(main);
+	free(body);
+
+	return MUNIT_OK;
+}
+
+/* Large databases are streamed in chunks pointing to the snapshot pages */
+TEST_CASE(dump, streamed, NULL)
+{
+	(void)params;
+	struct request_dump_fixture *f = data;
+	unsigned chunks;
+
+	OPEN;
+	EXEC("CREATE TABLE test (n INT, data BLOB)");
+	EXEC("INSERT INTO test (n, data) VALUES (1, randomblob(200000))");
+
+	f->request = (struct request_dump){
+		.filename = "test",
+	};
+	ENCODE(&f->request, dump);
+	HANDLE(DUMP);
+	ASSERT_CALLBACK(DQLITE_OK, FILES);
+	munit_assert_int(f->handle->stream_len, >, 0);
+	munit_assert_int(f->handle->stream_len % 8, ==, 0);
+
+	char *body = dumpStream(f, &chunks);
+	munit_assert_int(chunks, >, 1);
+	munit_assert_ptr_null(f->gateway->dump);
+
+	DECODE(&f->response, files);
+	munit_assert_int(f->response.n, ==, 2);
+	struct file main = {};
+	DECODE_FILE(&main);
+	munit_assert_string_equal(main.name, "test");
+	munit_assert_int(main.content.len, >, 200000);
+
+	struct file wal = {};
+	DECODE_FILE(&wal);
+	munit_assert_string_equal(wal.name, "test-wal");
+	munit_assert_int(wal.content.len, ==, 0);
+	munit_assert_int(f->cursor->cap, ==, 0);
+
+	INTEGRITY_CHECK(main);
+	free(body);
 
 	return MUNIT_OK;
 }
@@ -83,3 +83,41 @@ TEST_CASE(db, get_existing, NULL)
 	munit_assert_ptr_equal(db1, db2);
 	return MUNIT_OK;
 }
+
+/* Look up a db that was never registered. */
+TEST_CASE(db, get_missing, NULL)
+{
+	struct db_fixture *f = data;
+	struct db *db;
+	(void)params;
+	int rc;
+	munit_assert_ptr_null(registry__get(&f->registry, "test.db"));
+	rc = registry__get_or_create(&f->registry, "test.db", &db);
+	munit_assert_int(rc, ==, 0);
+	munit_assert_ptr_null(registry__get(&f->registry, "other.db"));
+	return MUNIT_OK;
+}
+
+/* Register enough dbs to grow the hash table several times. */
+TEST_CASE(db, get_many, NULL)
+{
+	struct db_fixture *f = data;
+	struct db *dbs[200];
+	char filename[16];
+	unsigned i;
+	(void)params;
+	int rc;
+	for (i = 0; i < 200; i++) {
+		sprintf(filename, "%u.db", i);
+		rc = registry__get_or_create(&f->registry, filename, &dbs[i]);
+		munit_assert_int(rc, ==, 0);
+	}
+	munit_assert_ulong(registry__size(&f->registry), ==, 200);
+	for (i = 0; i < 200; i++) {
+		sprintf(filename, "%u.db", i);
+		munit_assert_ptr_equal(registry__get(&f->registry, filename),
+				       dbs[i]);
+		munit_assert_string_equal(dbs[i]->filename, filename);
+	}
+	return MUNIT_OK;
+}
@@ -169,6 +169,40 @@ TEST_CASE(init, conn, NULL)
 	return MUNIT_OK;
 }
 
+/* The connection of a closed leader is handed to the next one. */
+TEST_CASE(init, reuse_conn, NULL)
+{
+	struct init_fixture *f = data;
+	struct db *db = f->leaders[0].db;
+	sqlite3 *conn = CONN(0);
+	int rc;
+	(void)params;
+	TEAR_DOWN_LEADER(0);
+	munit_assert_uint(db->n_idle, ==, 1);
+	rc = leader__init(LEADER(0), db, CLUSTER_RAFT(0));
+	munit_assert_int(rc, ==, 0);
+	munit_assert_ptr_equal(CONN(0), conn);
+	munit_assert_uint(db->n_idle, ==, 0);
+	return MUNIT_OK;
+}
+
+/* A connection whose state was changed by its leader is not reused. */
+TEST_CASE(init, tainted_conn, NULL)
+{
+	struct init_fixture *f = data;
+	struct db *db0 = f->leaders[0].db;
+	char *errmsg;
+	int rc;
+	(void)params;
+	rc = sqlite3_exec(CONN(0), "PRAGMA foreign_keys=ON", NULL, NULL,
+			  &errmsg);
+	munit_assert_int(rc, ==, 0);
+	TEAR_DOWN_LEADER(0);
+	munit_assert_uint(db0->n_idle, ==, 0);
+	SETUP_LEADER(0);
+	return MUNIT_OK;
+}
+
 /******************************************************************************
  *
  * leader_exec
@@ -243,6 +277,58 @@ TEST_CASE(exec, success, NULL)
 	return MUNIT_OK;
 }
 
+#ifdef LZ4_AVAILABLE
+/* Compressed pages are applied by all nodes. */
+TEST_CASE(exec, frames_compression, NULL)
+{
+	struct exec_fixture *f = data;
+	sqlite3_stmt *stmt;
+	int rv;
+	(void)params;
+	f->servers[0].config.frames_compression = true;
+	CLUSTER_ELECT(0);
+	EXEC_SQL(0, "CREATE TABLE test (t TEXT)");
+	EXEC_SQL(0, "INSERT INTO test(t) VALUES(printf('%.*c', 1000, 'x'))");
+	munit_assert_int(f->status, ==, 0);
+
+	rv = sqlite3_prepare_v2(CONN(1), "SELECT length(t) FROM test", -1,
+				&stmt, NULL);
+	munit_assert_int(rv, ==, SQLITE_OK);
+	rv = sqlite3_step(stmt);
+	munit_assert_int(rv, ==, SQLITE_ROW);
+	munit_assert_int(sqlite3_column_int(stmt, 0), ==, 1000);
+	sqlite3_finalize(stmt);
+	return MUNIT_OK;
+}
+#endif
+
+/* A transaction whose pages don't fit in one entry is split across several
+ * ones, and applied by all nodes once the last one is. */
+TEST_CASE(exec, transaction_chunks, NULL)
+{
+	struct exec_fixture *f = data;
+	sqlite3_stmt *stmt;
+	raft_index index;
+	int rv;
+	(void)params;
+	f->servers[0].config.tx_chunk_size = f->servers[0].config.vfs.page_size;
+	CLUSTER_ELECT(0);
+	EXEC_SQL(0, "CREATE TABLE test (t TEXT)");
+	index = CLUSTER_LAST_INDEX(0);
+	EXEC_SQL(0, "INSERT INTO test(t) VALUES(printf('%.*c', 20000, 'x'))");
+	munit_assert_int(f->status, ==, 0);
+	munit_assert_uint64(CLUSTER_LAST_INDEX(0), >, index + 4);
+
+	rv = sqlite3_prepare_v2(CONN(1), "SELECT length(t) FROM test", -1,
+				&stmt, NULL);
+	munit_assert_int(rv, ==, SQLITE_OK);
+	rv = sqlite3_step(stmt);
+	munit_assert_int(rv, ==, SQLITE_ROW);
+	munit_assert_int(sqlite3_column_int(stmt, 0), ==, 20000);
+	sqlite3_finalize(stmt);
+	return MUNIT_OK;
+}
+
 TEST_CASE(exec, barrier_fails, NULL)
 {
 	struct exec_fixture *f = data;